@@ -0,0 +1,111 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/bayes/CParticleFilter.h>
+#include <mrpt/math/TPose2D.h>
+#include <mrpt/obs/CActionCollection.h>
+#include <mrpt/obs/CSensoryFrame.h>
+#include <mrpt/random/RandomGenerators.h>
+#include <mrpt/slam/CMonteCarloLocalization2D.h>
+
+#include <functional>
+#include <vector>
+
+/**
+ * A bank of independent small SE(2) particle filters, one per candidate area
+ * of a global (re)localization, instead of one large particle set covering
+ * all candidates.
+ *
+ * Each member keeps the cumulative log-likelihood of all observations since
+ * the bank was created, so members can be compared among them, and unlikely
+ * ones are pruned after each step.
+ *
+ * Members are stepped sequentially: MRPT particle filters draw samples from
+ * the global random generator, and maps build likelihood caches lazily on
+ * first use, so they cannot be safely shared by concurrent PF steps.
+ */
+class FilterBank
+{
+   public:
+	struct Parameters
+	{
+		/// Candidates closer than this distance [m] are grouped into the
+		/// same member.
+		double min_candidate_distance = 2.0;
+
+		/// Maximum number of members.
+		unsigned int max_filters = 8;
+
+		/// Members whose cumulative likelihood is below this ratio of that
+		/// of the best member are discarded.
+		double prune_likelihood_ratio = 1e-3;
+
+		/// Number of particles of each member, shared among all candidates
+		/// of its cluster, regardless of how many candidates it has.
+		unsigned int particles_per_member = 50;
+	};
+
+	struct Member
+	{
+		mrpt::slam::CMonteCarloLocalization2D pdf;
+		mrpt::bayes::CParticleFilter::TParticleFilterStats pf_stats;
+
+		/// Sum of the log-likelihood of all observations since the bank was
+		/// created, up to an additive constant shared by all members.
+		double cumulative_log_lik = .0;
+	};
+
+	/** An additional observation model, applied to each member after its PF
+	 *  step. It must update the particle weights, and return the
+	 *  log-likelihood of its observations given the member former weights,
+	 *  up to a constant shared by all members.
+	 */
+	using extra_likelihood_t = std::function<double(mrpt::slam::CMonteCarloLocalization2D&)>;
+
+	FilterBank() = default;
+	explicit FilterBank(const Parameters& p) : params(p) {}
+
+	Parameters params;
+
+	/// Empty if the filter bank mode is not active.
+	std::vector<Member> members;
+
+	bool empty() const { return members.empty(); }
+	size_t size() const { return members.size(); }
+	void clear() { members.clear(); }
+
+	/** Groups candidate poses into clusters of nearby poses, one per future
+	 *  member, according to params.
+	 */
+	std::vector<std::vector<mrpt::math::TPose2D>> cluster_candidates(
+		const std::vector<mrpt::math::TPose2D>& candidates) const;
+
+	/** Replaces all members with one per cluster (as returned by
+	 *  cluster_candidates()), each with `params.particles_per_member`
+	 *  particles drawn around the cluster candidates in turn, with the given
+	 *  standard deviations in (x,y) [m] and phi [rad].
+	 */
+	void create_members(
+		const std::vector<std::vector<mrpt::math::TPose2D>>& clusters, double sigmaXY,
+		double sigmaPhi, mrpt::random::CRandomGenerator& rng);
+
+	/// Total number of particles of all members.
+	size_t particle_count() const;
+
+	/** Runs one PF step for each member, adds the optional extra likelihood
+	 *  term, and prunes unlikely members.
+	 *  \return The index of the best member (in `members`, after pruning).
+	 */
+	size_t step(
+		const mrpt::obs::CActionCollection& actions, const mrpt::obs::CSensoryFrame& sf,
+		const mrpt::slam::TMonteCarloLocalizationParams& pdfOptions,
+		const mrpt::bayes::CParticleFilter::TParticleFilterOptions& pfOptions,
+		const extra_likelihood_t& extraLikelihood = {});
+};
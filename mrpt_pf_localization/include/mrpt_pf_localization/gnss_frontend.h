@@ -0,0 +1,150 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mp2p_icp/metricmap.h>
+#include <mrpt/math/CMatrixFixed.h>
+#include <mrpt/math/TPoint3D.h>
+#include <mrpt/math/TPose2D.h>
+#include <mrpt/math/TPose3D.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/topography/data_types.h>	 // TGeodeticCoords
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Converts geodetic coordinates (e.g. from GNSS receivers) into the frame of
+ * a georeferenced map.
+ *
+ * Everything that only depends on the map georeferencing (the ECEF origin,
+ * and the ECEF->ENU->map rotation) is computed once in the constructor, so
+ * each conversion is just one geodetic->ECEF conversion plus one rigid
+ * transformation.
+ *
+ * A faster local tangent-plane approximation is also provided, together with
+ * an upper bound of its error, so it can be used safely near the map origin.
+ */
+class GnssToMapConverter
+{
+   public:
+	GnssToMapConverter() = default;
+
+	explicit GnssToMapConverter(const mp2p_icp::metric_map_t::Georeferencing& georef);
+
+	/// Exact conversion: geodetic -> ECEF -> map
+	mrpt::math::TPoint3D to_map(const mrpt::topography::TGeodeticCoords& c) const;
+
+	/// Local tangent-plane approximation, using the curvature radii at the
+	/// georeferencing origin. See tangent_plane_error_bound().
+	mrpt::math::TPoint3D to_map_tangent_plane(const mrpt::topography::TGeodeticCoords& c) const;
+
+	/** Upper bound of the error [m] of to_map_tangent_plane() for a point at
+	 *  the given horizontal distance and height difference with respect to
+	 *  the georeferencing origin.
+	 */
+	double tangent_plane_error_bound(double horizontal_distance, double height_diff = 0) const;
+
+	/** Uses the tangent-plane approximation if its error bound is below
+	 *  `max_error` [m], or the exact conversion otherwise.
+	 */
+	mrpt::math::TPoint3D to_map(
+		const mrpt::topography::TGeodeticCoords& c, double max_error) const;
+
+	/// Batch version of to_map(c, max_error)
+	void to_map(
+		const std::vector<mrpt::topography::TGeodeticCoords>& in,
+		std::vector<mrpt::math::TPoint3D>& out, double max_error) const;
+
+	/// The rotation from ENU to map frame (to transform covariances)
+	const mrpt::math::CMatrixDouble33& rotation_map_enu() const { return R_map_enu_; }
+
+   private:
+	mrpt::topography::TGeodeticCoords origin_;
+
+	/// P_map = R_map_ecef_ * P_ecef + t_map_ecef_
+	mrpt::math::CMatrixDouble33 R_map_ecef_ = mrpt::math::CMatrixDouble33::Identity();
+	mrpt::math::TPoint3D t_map_ecef_{0, 0, 0};
+
+	mrpt::poses::CPose3D T_map_enu_;
+	mrpt::math::CMatrixDouble33 R_map_enu_ = mrpt::math::CMatrixDouble33::Identity();
+
+	// Tangent-plane scale factors at the origin [m/rad]:
+	double east_per_rad_lon_ = 0, north_per_rad_lat_ = 0;
+	double min_curvature_radius_ = 1;
+	double tan_lat0_ = 0;
+};
+
+/**
+ * A batch of GNSS fixes, already converted into the map frame, to be fused as
+ * likelihood observations into the weights of one or more particle sets.
+ */
+struct GnssLikelihoodBatch
+{
+	std::vector<mrpt::math::TPoint3D> meas_in_map;
+	std::vector<mrpt::math::TPoint3D> antenna_on_robot;
+	std::vector<mrpt::math::CMatrixDouble22> info_xy;  //!< Inverse covariances
+
+	bool empty() const { return meas_in_map.empty(); }
+
+	/** Adds the log-likelihood of all fixes to the log-weight of each particle
+	 *  (of type TPose2D or TPose3D), and returns the log-likelihood of the
+	 *  batch given the former weights, up to a constant that only depends on
+	 *  the batch. Weights are not normalized.
+	 */
+	template <class PARTICLE_LIST>
+	double update_weights(PARTICLE_LIST& particles) const
+	{
+		if (particles.empty()) return .0;
+
+		// log(sum(exp(log_w))), in a stable way:
+		const auto logSum = [&particles]()
+		{
+			double maxLogW = -std::numeric_limits<double>::max();
+			for (const auto& part : particles) maxLogW = std::max(maxLogW, part.log_w);
+			double sum = 0;
+			for (const auto& part : particles) sum += std::exp(part.log_w - maxLogW);
+			return maxLogW + std::log(sum);
+		};
+
+		const double logSumBefore = logSum();
+
+		for (auto& part : particles)
+		{
+			double logLik = 0;
+			for (size_t k = 0; k < meas_in_map.size(); k++)
+			{
+				const auto& a = antenna_on_robot[k];
+				double ax, ay;
+				if constexpr (std::is_same_v<std::decay_t<decltype(part.d)>, mrpt::math::TPose2D>)
+				{
+					const double c = std::cos(part.d.phi), s = std::sin(part.d.phi);
+					ax = part.d.x + c * a.x - s * a.y;
+					ay = part.d.y + s * a.x + c * a.y;
+				}
+				else
+				{
+					mrpt::math::TPoint3D g;
+					part.d.composePoint(a, g);
+					ax = g.x;
+					ay = g.y;
+				}
+				const double dx = ax - meas_in_map[k].x, dy = ay - meas_in_map[k].y;
+				const auto& I = info_xy[k];
+				logLik -= 0.5 * (I(0, 0) * dx * dx + 2 * I(0, 1) * dx * dy + I(1, 1) * dy * dy);
+			}
+			part.log_w += logLik;
+		}
+
+		return logSum() - logSumBefore;
+	}
+};
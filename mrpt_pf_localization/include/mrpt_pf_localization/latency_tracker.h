@@ -0,0 +1,83 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/system/CTimeLogger.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Fixed-resolution latency histogram, in seconds.
+ * Values beyond the last bin are accumulated in an overflow bin, but
+ * min/max/mean are always exact.
+ */
+class LatencyHistogram
+{
+   public:
+	explicit LatencyHistogram(double bin_width = 1e-3, size_t num_bins = 2000);
+
+	void add(double latency);
+
+	uint64_t count() const { return count_; }
+	double mean() const { return count_ ? sum_ / count_ : 0; }
+	double min() const { return count_ ? min_ : 0; }
+	double max() const { return count_ ? max_ : 0; }
+
+	/// Approximate percentile (p in [0,1]), up to the bin resolution.
+	double percentile(double p) const;
+
+   private:
+	double bin_width_;
+	std::vector<uint64_t> bins_;  //!< Last one is the overflow bin
+	uint64_t count_ = 0;
+	double sum_ = 0, min_ = 0, max_ = 0;
+};
+
+/**
+ * Thread-safe collection of latency histograms, per input topic and per
+ * processing stage, all measured with respect to the sensor timestamp.
+ */
+class LatencyTracker
+{
+   public:
+	enum class Stage : uint8_t
+	{
+		/// Message received in its subscription callback
+		Arrival = 0,
+		/// Observation included in a PF step
+		Step,
+		/// PF result (map->odom /tf and pose) published
+		Publish
+	};
+
+	static const char* stage_name(Stage s);
+
+	void add(const std::string& topic, Stage stage, double latency);
+
+	using Key = std::pair<std::string, Stage>;
+
+	/// Thread-safe copy of all histograms
+	std::map<Key, LatencyHistogram> snapshot() const;
+
+	void clear();
+
+	/** Writes one CSV row per (topic,stage), plus one row per section in
+	 * `profiler` (if provided). All times in milliseconds.
+	 */
+	void write_csv(std::ostream& o, const mrpt::system::CTimeLogger* profiler = nullptr) const;
+
+   private:
+	mutable std::mutex mtx_;
+	std::map<Key, LatencyHistogram> histograms_;
+};
@@ -31,6 +31,8 @@
 #include <mrpt/slam/CMonteCarloLocalization3D.h>
 #include <mrpt/system/COutputLogger.h>
 #include <mrpt/system/CTimeLogger.h>
+#include <mrpt_pf_localization/filter_bank.h>
+#include <mrpt_pf_localization/gnss_frontend.h>
 
 #include <mutex>
 #include <optional>
@@ -122,6 +124,13 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 		std::optional<mrpt::maps::COccupancyGridMap2D::TLikelihoodOptions>
 			override_likelihood_gridmaps;
 
+		/** If true, the likelihood-field cache of occupancy grids is filled
+		 * for all cells upon each map update, so it is not built within the
+		 * PF steps that follow. This costs one likelihood evaluation per grid
+		 * cell. KD-trees of point maps are always built upon map updates.
+		 */
+		bool precompute_likelihood_cache = false;
+
 		/** Number of particles/m² to use upon initialization.
 		 *  Can be changed while state = UNINITIALIZED.
 		 */
@@ -142,6 +151,24 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 		/// samples around the GNSS prediction:
 		double gnss_samples_num_sigmas = 6.0;
 
+		/** If true (and the map is georeferenced), all GNSS fixes received
+		 * between PF steps are fused as likelihood observations, weighting
+		 * particles by how well they explain each fix.
+		 */
+		bool gnss_likelihood_enable = false;
+
+		/// Fixes older than this [s] with respect to the PF step observations
+		/// are not fused as likelihood observations.
+		double gnss_likelihood_max_age = 0.25;
+
+		/// Minimum horizontal standard deviation [m] of GNSS fixes, to avoid
+		/// particle depletion with overconfident (e.g. RTK) covariances.
+		double gnss_likelihood_min_std = 0.10;
+
+		/// Maximum error [m] allowed to use the local tangent-plane
+		/// approximation for geodetic to map conversions.
+		double gnss_tangent_plane_max_error = 0.01;
+
 		/// The number of standard deviations ("sigmas") to use as the area in
 		/// which to draw random samples around the input initialization pose
 		/// (when NOT using GNSS as input)
@@ -161,6 +188,30 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 		mp2p_icp::Parameters relocalization_icp_params;
 
 		mp2p_icp_filters::FilterPipeline relocalization_obs_filter;
+
+		/** If true, and relocalization ends up with several, distant
+		 * candidate areas, one independent small particle filter is run per
+		 * candidate area instead of merging all candidates into one large
+		 * particle set. Filters are pruned as
+		 * their likelihood drops, and the best one is exposed as the main
+		 * estimate. So far, only for SE(2) mode.
+		 */
+		bool filter_bank_enable = false;
+
+		/// Relocalization candidates closer than this distance [m] are
+		/// grouped into the same filter of the bank.
+		double filter_bank_min_candidate_distance = 2.0;
+
+		/// Maximum number of independent filters in the bank.
+		unsigned int filter_bank_max_filters = 8;
+
+		/// Filters whose cumulative likelihood is below this ratio of that
+		/// of the best filter are discarded.
+		double filter_bank_prune_likelihood_ratio = 1e-3;
+
+		/// Number of particles of each filter in the bank, regardless of
+		/// how many relocalization candidates it covers.
+		unsigned int filter_bank_particles_per_member = 50;
 		mp2p_icp::ParameterSource paramSource;
 
 		/// This method loads all parameters from the YAML, except the
@@ -197,6 +248,17 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 	 */
 	void on_observation(const mrpt::obs::CObservation::Ptr& obs);
 
+	/** Batch version of on_observation(): the input queue is locked only
+	 *  once for the whole set of observations. This is the preferred entry
+	 *  point for rawlog replays or bridges feeding many sensors at once.
+	 */
+	void on_observations(const std::vector<mrpt::obs::CObservation::Ptr>& obs);
+
+	/** \overload Takes ownership of the smart pointers in the input vector,
+	 *  which is left empty upon return.
+	 */
+	void on_observations(std::vector<mrpt::obs::CObservation::Ptr>&& obs);
+
 	/** The main API call: executes one PF step, taking into account all the
 	 * parameters and observations gathered so far, updates the optional GUI,
 	 * etc.
@@ -217,7 +279,8 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 		const std::string& map_config_ini_file, const std::string& simplemap_file);
 
 	/** Defines the map to use from a multimetric map, which may contain
-	 * gridmaps, pointclouds, etc.
+	 * gridmaps, pointclouds, etc. Map caches (KD-trees, likelihood fields)
+	 * are built in the caller thread, before the PF starts using the map.
 	 */
 	void set_map_from_metric_map(
 		const mrpt::maps::CMultiMetricMap::Ptr& metricMap,
@@ -242,6 +305,16 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 	/** Returns a *copy* (it is intentional) of the parameters at this moment */
 	const Parameters getParams() { return params_; }
 
+	/// Access to the internal profiler. Note that it is not thread-safe, so
+	/// use it from the same thread that runs step(), the only one using it.
+	const mrpt::system::CTimeLogger& getProfiler() const { return profiler_; }
+
+	/** Sensor label and timestamp of the observations (including GNSS fixes)
+	 *  used in the last PF update. Empty if the last step() did not update
+	 *  the filter.
+	 */
+	std::vector<std::pair<std::string, mrpt::Clock::time_point>> getLastStepObservations();
+
 	/** Returns the last filter estimate, or empty ptr if never run yet.
 	 *  Multi thread safe.
 	 */
@@ -261,6 +334,9 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 		mrpt::maps::CMultiMetricMap::Ptr metric_map;  //!< Empty=uninitialized
 		std::optional<mp2p_icp::metric_map_t::Georeferencing> georeferencing;
 
+		/// Cached geodetic to map conversion for the current georeferencing
+		std::optional<GnssToMapConverter> gnss_to_map;
+
 		mrpt::bayes::CParticleFilter pf;  ///< interface for particle filters
 
 		mrpt::bayes::CParticleFilter::TParticleFilterStats pf_stats;
@@ -279,6 +355,10 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 		 */
 		std::vector<mrpt::obs::CObservation::Ptr> pendingObs;
 
+		/// Whether pendingObs contains any odometry observation.
+		/// Protected by the same mutex than pendingObs.
+		bool pendingObsHasOdometry = false;
+
 		/** The last state of the filter, for sending as a copy to the user API
 		 */
 		mrpt::poses::CPose3DPDFParticles::Ptr lastResult;
@@ -287,6 +367,14 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 
 		struct Relocalization;
 		mrpt::pimpl<Relocalization> pendingRelocalization;
+
+		/// See getLastStepObservations()
+		std::vector<std::pair<std::string, mrpt::Clock::time_point>> lastStepObservations;
+
+		/// Bank of independent filters (see Parameters::filter_bank_enable).
+		/// Empty if the filter bank mode is not active. Otherwise, the best
+		/// member is copied into pdf2d after each step.
+		FilterBank filterBank;
 	};
 
 	mrpt::obs::CObservationGPS::Ptr get_last_gnss_obs() const
@@ -302,10 +390,18 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 	std::mutex pendingObsMtx_;
 	mrpt::obs::CObservationGPS::Ptr last_gnss_;	 // use mtx: pendingObsMtx_
 
+	/// All GGA fixes since the last PF step. Use mtx: pendingObsMtx_
+	std::vector<mrpt::obs::CObservationGPS::Ptr> pending_gnss_;
+
 	mrpt::system::CTimeLogger profiler_{true /*enabled*/, "mrpt_pf_localization" /*name*/};
 
 	mrpt::gui::CDisplayWindow3D::Ptr win3D_;
 
+	/** Classifies the observation by its class ID and appends it to the
+	 *  input queue. The caller must hold pendingObsMtx_.
+	 */
+	void internal_enqueue_observation(mrpt::obs::CObservation::Ptr&& obs);
+
 	/** To be called only when state=UNINITIALIZED.
 	 * Checks if the minimum set of params are set, then move state to
 	 *TO_BE_INITIALIZED
@@ -324,5 +420,18 @@ class PFLocalizationCore : public mrpt::system::COutputLogger
 
 	void internal_fill_state_lastResult();
 
+	/// Runs one PF step for each member of state_.filterBank, fusing the
+	/// GNSS batch (if not empty) into each member, prunes unlikely members,
+	/// and copies the best one into state_.pdf2d.
+	void run_filter_bank_step(
+		const mrpt::obs::CActionCollection& actions, const mrpt::obs::CSensoryFrame& sf,
+		const GnssLikelihoodBatch& gnss);
+
 	std::optional<mrpt::poses::CPose3DPDFGaussian> get_gnss_pose_prediction();
+
+	/// Converts the usable GNSS fixes into a batch of likelihood
+	/// observations in the map frame (empty if none is usable).
+	GnssLikelihoodBatch prepare_gnss_likelihood(
+		const std::vector<mrpt::obs::CObservationGPS::Ptr>& fixes,
+		const mrpt::Clock::time_point& stepStamp);
 };
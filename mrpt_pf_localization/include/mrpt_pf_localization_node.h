@@ -10,12 +10,20 @@
 
 #include <mrpt/math/TTwist3D.h>
 #include <mrpt/obs/CObservationOdometry.h>
+#include <mrpt_pf_localization/latency_tracker.h>
 #include <mrpt_pf_localization/mrpt_pf_localization_core.h>
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2_ros/transform_listener.h>
 
+#include <array>
+#include <condition_variable>
 #include <cstring>	// size_t
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include <geometry_msgs/msg/pose_array.hpp>
 #include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
@@ -31,6 +39,7 @@
 #include <sensor_msgs/msg/point_cloud2.hpp>
 #include <std_msgs/msg/header.hpp>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
 
 #include "mrpt_msgs/msg/generic_object.hpp"
 
@@ -77,8 +86,39 @@ class PFLocalizationNode : public rclcpp::Node
 		std::string topic_odometry = "/odom";
 
 		std::string pub_topic_particles = "/particlecloud";
+
+		/// Optional compact particles output, as a PointCloud2 with float
+		/// fields (x, y, yaw, weight). Leave empty to disable.
+		std::string pub_topic_particles_cloud;
+
+		/// Max number of particles to publish (0=all).
+		size_t particles_max_published = 0;
+
+		/// How to pick particles_max_published particles: "top_k" (highest
+		/// weights) or "systematic" (systematic sampling on the weights)
+		std::string particles_decimation_method = "systematic";
+
 		std::string pub_topic_pose = "/pf_pose";
 
+		/// High-rate global pose, published on each odometry message as the
+		/// last PF map->odom correction composed with the odometry pose.
+		/// Empty (default) to disable.
+		std::string pub_topic_fused_pose;
+
+		/// Track latencies of sensor messages (from their stamps) upon
+		/// arrival, inclusion in a PF step, and publication of the result.
+		bool latency_tracking_enable = true;
+
+		/// Topic to publish latency and profiler statistics (empty=disabled)
+		std::string pub_topic_diagnostics = "/diagnostics";
+
+		/// Period [s] for publishing diagnostics
+		double diagnostics_period = 1.0;
+
+		/// If not empty, latency and profiler statistics are saved to this
+		/// CSV file when the node is destroyed.
+		std::string latency_csv_file;
+
 		/// Comma "," separated list of topics to subscribe for LaserScan msgs
 		std::string topic_sensors_2d_scan;
 
@@ -87,6 +127,19 @@ class PFLocalizationNode : public rclcpp::Node
 
 		/// Topic name to subscribe for GNSS msgs:
 		std::string topic_gnss = "/gps";
+
+		/// If true, sensor poses on the robot (sensor frame -> base_link) are
+		/// looked up without waiting for /tf, and cached if they only
+		/// depend on /tf_static. The cache is cleared whenever /tf_static
+		/// changes.
+		bool cache_sensor_poses = true;
+
+		/// If true, only the latest laser/point cloud message per topic is
+		/// kept, and it is converted into an MRPT observation right before
+		/// the next PF step. Since the PF only uses the latest observation
+		/// per sensor, this avoids converting messages that would be
+		/// discarded anyway.
+		bool lazy_sensor_conversion = false;
 	};
 
 	NodeParameters nodeParams_;
@@ -107,8 +160,28 @@ class PFLocalizationNode : public rclcpp::Node
 	void reload_params_from_ros();
 
 	void loop();
-	void callbackLaser(const sensor_msgs::msg::LaserScan& msg, const std::string& topicName);
-	void callbackPointCloud(const sensor_msgs::msg::PointCloud2& msg, const std::string& topicName);
+	// Sensor callbacks take ownership of the message, so intra-process
+	// communication (if enabled) can hand it over without copies:
+	void callbackLaser(
+		sensor_msgs::msg::LaserScan::UniquePtr msg, const std::string& topicName);
+	void callbackPointCloud(
+		sensor_msgs::msg::PointCloud2::UniquePtr msg, const std::string& topicName);
+
+	/// Converts ROS sensor messages into MRPT observations. They return
+	/// nullptr if the sensor pose is not available.
+	mrpt::obs::CObservation::Ptr convertLaser(
+		sensor_msgs::msg::LaserScan::UniquePtr msg, const std::string& topicName);
+	mrpt::obs::CObservation::Ptr convertPointCloud(
+		sensor_msgs::msg::PointCloud2::UniquePtr msg, const std::string& topicName);
+
+	/// Converts and feeds into the PF the latest messages stored by the
+	/// sensor callbacks if lazy_sensor_conversion is enabled.
+	void convertPendingSensorMsgs();
+
+	/// Latest raw sensor message per topic. Use mtx: pendingSensorMsgsMtx_
+	std::map<std::string, sensor_msgs::msg::LaserScan::UniquePtr> pendingLaserMsgs_;
+	std::map<std::string, sensor_msgs::msg::PointCloud2::UniquePtr> pendingPointCloudMsgs_;
+	std::mutex pendingSensorMsgsMtx_;
 
 	void callbackGNSS(const sensor_msgs::msg::NavSatFix& msg);
 
@@ -117,13 +190,29 @@ class PFLocalizationNode : public rclcpp::Node
 	void callbackInitialpose(const geometry_msgs::msg::PoseWithCovarianceStamped& msg);
 	void callbackOdometry(const nav_msgs::msg::Odometry&);
 
-	void callbackMap(const mrpt_msgs::msg::GenericObject& obj);
+	void callbackMap(mrpt_msgs::msg::GenericObject::UniquePtr obj);
+
+	/// Maps are deserialized and passed to the PF core in this thread, so
+	/// large maps do not block the executor:
+	void mapWorkerThread();
+	void processMapMsg(const mrpt_msgs::msg::GenericObject& obj);
+
+	std::thread mapWorker_;
+	std::mutex mapWorkerMtx_;
+	std::condition_variable mapWorkerCv_;
+	mrpt_msgs::msg::GenericObject::UniquePtr pendingMapMsg_;  // mtx: mapWorkerMtx_
+	bool mapWorkerQuit_ = false;  // mtx: mapWorkerMtx_
 
 	/// Publish the PF output mean to /tf
 	void publishTF();
 	/// Publish the PF output as a PoseArray & PoseWithCovarianceStamped msg
 	void publishParticlesAndStampedPose();
 
+	/// Indices of the particles to publish, according to
+	/// particles_max_published and particles_decimation_method
+	std::vector<size_t> selectParticlesToPublish(
+		const mrpt::poses::CPose3DPDFParticles& parts) const;
+
 	void updateEstimatedTwist();
 	void createOdometryFromTwist();
 
@@ -144,8 +233,28 @@ class PFLocalizationNode : public rclcpp::Node
 	rclcpp::Subscription<sensor_msgs::msg::NavSatFix>::SharedPtr subGNSS_;
 
 	rclcpp::Publisher<geometry_msgs::msg::PoseArray>::SharedPtr pubParticles_;
+	rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr pubParticlesCloud_;
 
 	rclcpp::Publisher<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr pubPose_;
+	rclcpp::Publisher<geometry_msgs::msg::PoseWithCovarianceStamped>::SharedPtr pubFusedPose_;
+	rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr pubDiagnostics_;
+
+	// Latency tracking:
+	LatencyTracker latency_;
+
+	/// Stamps used in the last PF step, pending to account for their
+	/// publication latency. Use mtx: tfMapOdomToPublishMtx_
+	std::vector<std::pair<std::string, mrpt::Clock::time_point>> pendingPublishLatency_;
+
+	std::optional<rclcpp::Time> lastDiagnosticsPub_;
+
+	void trackArrival(const std::string& topic, const builtin_interfaces::msg::Time& stamp);
+
+	/// Records the step latency of the observations used in the last PF
+	/// step, and returns their topics and stamps.
+	std::vector<std::pair<std::string, mrpt::Clock::time_point>> collectSteppedStamps();
+
+	void publishDiagnostics();
 
 	std::shared_ptr<tf2_ros::Buffer> tf_buffer_;
 	std::shared_ptr<tf2_ros::TransformListener> tf_listener_;
@@ -153,14 +262,71 @@ class PFLocalizationNode : public rclcpp::Node
 	std::shared_ptr<tf2_ros::TransformBroadcaster> tf_broadcaster_;
 
 	std::optional<mrpt::Clock::time_point> last_sensor_stamp_;
+	mutable std::mutex lastSensorStampMtx_;
+
+	std::optional<mrpt::Clock::time_point> get_last_sensor_stamp() const
+	{
+		std::lock_guard<std::mutex> lck(lastSensorStampMtx_);
+		return last_sensor_stamp_;
+	}
+	void set_last_sensor_stamp(const mrpt::Clock::time_point& t)
+	{
+		std::lock_guard<std::mutex> lck(lastSensorStampMtx_);
+		last_sensor_stamp_ = t;
+	}
+
+	/// Callback groups. All are mutually exclusive internally, but can run
+	/// in parallel with a multi-threaded executor:
+	/// - sensors: sensor, odometry, GNSS and /tf_static subscriptions.
+	/// - loop: the PF main loop timer.
+	/// - output: the /tf republishing timer.
+	/// - map: map and initial pose subscriptions.
+	rclcpp::CallbackGroup::SharedPtr cbGroupSensors_, cbGroupLoop_, cbGroupOutput_, cbGroupMap_;
 
 	void useROSLogLevel();
 
+	/// A zero timeout is a non-blocking poll, whose failures are expected
+	/// (e.g. before /tf_static arrives), so they are only logged as
+	/// throttled warnings.
 	[[nodiscard]] bool waitForTransform(
 		mrpt::poses::CPose3D& des, const std::string& target_frame, const std::string& source_frame,
 		const int timeoutMilliseconds = 50);
 
+	/// Gets the pose of a sensor frame wrt base_link, from the cache if
+	/// possible, without blocking on /tf if cache_sensor_poses is enabled.
+	[[nodiscard]] bool getSensorPose(mrpt::poses::CPose3D& des, const std::string& sensorFrame);
+
+	/// True if `frame` and `referenceFrame` are connected through /tf_static
+	/// transforms only. The caller must hold sensorPosesCacheMtx_.
+	bool isStaticTransform(const std::string& frame, const std::string& referenceFrame) const;
+
+	void callbackTfStatic(const tf2_msgs::msg::TFMessage& msg);
+
+	rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr subTfStatic_;
+
+	/// Sensor frame_id -> pose wrt base_link. Only for poses that only
+	/// depend on /tf_static.
+	std::map<std::string, mrpt::poses::CPose3D> sensorPosesCache_;
+
+	/// child frame_id -> parent frame_id, for all /tf_static transforms.
+	std::map<std::string, std::string> staticTfParents_;
+
+	std::mutex sensorPosesCacheMtx_;  //!< For both maps above
+
 	void update_tf_pub_data();
 	std::optional<geometry_msgs::msg::TransformStamped> tfMapOdomToPublish_;
+
+	/// Last PF map->odom correction, with the uncertainty of the PF
+	/// estimate. Use mtx: tfMapOdomToPublishMtx_
+	std::optional<geometry_msgs::msg::PoseWithCovariance> mapOdomCorrection_;
+
+	/// Covariance of the last odometry message, and its value when
+	/// mapOdomCorrection_ was computed. Use mtx: tfMapOdomToPublishMtx_
+	std::array<double, 36> lastOdomCov_{}, odomCovAtCorrection_{};
+
 	std::mutex tfMapOdomToPublishMtx_;
+
+	/// Publishes map->base_link = (last map->odom correction) (+) odometry,
+	/// with the odometry uncertainty accumulated since that correction only.
+	void publishFusedPose(const nav_msgs::msg::Odometry& odom);
 };
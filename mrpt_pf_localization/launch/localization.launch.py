@@ -136,7 +136,7 @@ def generate_launch_description():
                         "base_link_frame_id": LaunchConfiguration('base_link_frame_id'),
                         "odom_frame_id": LaunchConfiguration('odom_frame_id'),
                         "global_frame_id": LaunchConfiguration('global_frame_id'),
-                    }]
+                    }],
             )
         ]
     )
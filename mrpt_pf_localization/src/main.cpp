@@ -13,7 +13,13 @@ int main(int argc, char** argv)
 {
 	rclcpp::init(argc, argv);
 	auto node = std::make_shared<PFLocalizationNode>();
-	rclcpp::spin(std::dynamic_pointer_cast<rclcpp::Node>(node));
+
+	// Multi-threaded executor, so /tf keeps being published and sensors
+	// received while a PF step is running (see the node callback groups):
+	rclcpp::executors::MultiThreadedExecutor executor;
+	executor.add_node(node);
+	executor.spin();
+
 	rclcpp::shutdown();
 	return 0;
 }
\ No newline at end of file
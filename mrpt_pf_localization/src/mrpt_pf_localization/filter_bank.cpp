@@ -0,0 +1,169 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#include <mrpt/core/bits_math.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt_pf_localization/filter_bank.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+namespace
+{
+/// log(sum(exp(log_w[i]))) for all particles, computed in a stable way.
+double log_sum_weights(const mrpt::bayes::CParticleFilterCapable& pfc)
+{
+	const size_t N = pfc.particlesCount();
+	if (!N) return -std::numeric_limits<double>::infinity();
+
+	double maxLogW = pfc.getW(0);
+	for (size_t i = 1; i < N; i++) mrpt::keep_max(maxLogW, pfc.getW(i));
+
+	double sum = 0;
+	for (size_t i = 0; i < N; i++) sum += std::exp(pfc.getW(i) - maxLogW);
+
+	return maxLogW + std::log(sum);
+}
+
+/** Same steps as mrpt::bayes::CParticleFilter::executeOn(), but also
+ * returns an estimate of the log-likelihood of the observations given all
+ * previous ones, p(z_t|z_{1:t-1}), which is needed to compare independent
+ * filters among them.
+ */
+double pf_execute_and_get_log_likelihood(
+	mrpt::bayes::CParticleFilterCapable& pfc, const mrpt::obs::CActionCollection& actions,
+	const mrpt::obs::CSensoryFrame& sf, const mrpt::bayes::CParticleFilter::TParticleFilterOptions& o,
+	mrpt::bayes::CParticleFilter::TParticleFilterStats& stats)
+{
+	using mrpt::bayes::CParticleFilter;
+
+	const double logSumBefore = log_sum_weights(pfc);
+
+	pfc.prediction_and_update(&actions, &sf, o);
+
+	// With dynamic sample size, particles are re-drawn (with equal weights)
+	// from the prior before the update, inside prediction_and_update():
+	const double logSumAfter = log_sum_weights(pfc);
+	const double logLik = o.adaptiveSampleSize
+							  ? logSumAfter - std::log(std::max<size_t>(1, pfc.particlesCount()))
+							  : logSumAfter - logSumBefore;
+
+	pfc.normalizeWeights();
+	stats.ESS_beforeResample = pfc.ESS();
+
+	if (!o.adaptiveSampleSize && (o.PF_algorithm == CParticleFilter::pfStandardProposal ||
+								  o.PF_algorithm == CParticleFilter::pfOptimalProposal))
+	{
+		if (stats.ESS_beforeResample < o.BETA) pfc.performResampling(o);
+	}
+
+	return logLik;
+}
+
+}  // namespace
+
+std::vector<std::vector<mrpt::math::TPose2D>> FilterBank::cluster_candidates(
+	const std::vector<mrpt::math::TPose2D>& candidates) const
+{
+	std::vector<std::vector<mrpt::math::TPose2D>> clusters;
+
+	const double minDist2 = mrpt::square(params.min_candidate_distance);
+	for (const auto& pose : candidates)
+	{
+		std::optional<size_t> nearestIdx;
+		double nearestDist2 = std::numeric_limits<double>::max();
+		for (size_t k = 0; k < clusters.size(); k++)
+		{
+			const auto& seed = clusters[k].front();
+			const double d2 = mrpt::square(seed.x - pose.x) + mrpt::square(seed.y - pose.y);
+			if (d2 < nearestDist2)
+			{
+				nearestDist2 = d2;
+				nearestIdx = k;
+			}
+		}
+		if (nearestIdx && (nearestDist2 < minDist2 || clusters.size() >= params.max_filters))
+			clusters[*nearestIdx].push_back(pose);
+		else
+			clusters.emplace_back(1, pose);
+	}
+	return clusters;
+}
+
+void FilterBank::create_members(
+	const std::vector<std::vector<mrpt::math::TPose2D>>& clusters, double sigmaXY,
+	double sigmaPhi, mrpt::random::CRandomGenerator& rng)
+{
+	ASSERT_GT_(params.particles_per_member, 0U);
+
+	members.clear();
+	for (const auto& cluster : clusters)
+	{
+		ASSERT_(!cluster.empty());
+		auto& m = members.emplace_back();
+		m.pdf.m_particles.reserve(params.particles_per_member);
+		for (size_t i = 0; i < params.particles_per_member; i++)
+		{
+			auto p = cluster[i % cluster.size()];
+			p.x += rng.drawGaussian1D(0, sigmaXY);
+			p.y += rng.drawGaussian1D(0, sigmaXY);
+			p.phi += rng.drawGaussian1D(0, sigmaPhi);
+			p.normalizePhi();
+			m.pdf.m_particles.emplace_back(p, 0.0 /*log weight*/);
+		}
+	}
+}
+
+size_t FilterBank::particle_count() const
+{
+	size_t n = 0;
+	for (const auto& m : members) n += m.pdf.size();
+	return n;
+}
+
+size_t FilterBank::step(
+	const mrpt::obs::CActionCollection& actions, const mrpt::obs::CSensoryFrame& sf,
+	const mrpt::slam::TMonteCarloLocalizationParams& pdfOptions,
+	const mrpt::bayes::CParticleFilter::TParticleFilterOptions& pfOptions,
+	const extra_likelihood_t& extraLikelihood)
+{
+	ASSERT_(!members.empty());
+
+	size_t bestIdx = 0;
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		auto& m = members[i];
+		m.pdf.options = pdfOptions;
+
+		m.cumulative_log_lik +=
+			pf_execute_and_get_log_likelihood(m.pdf, actions, sf, pfOptions, m.pf_stats);
+
+		if (extraLikelihood) m.cumulative_log_lik += extraLikelihood(m.pdf);
+
+		if (m.cumulative_log_lik > members[bestIdx].cumulative_log_lik) bestIdx = i;
+	}
+
+	// Prune unlikely members, and keep likelihoods relative to the best one
+	// to prevent them from growing unbounded:
+	const double bestLogLik = members[bestIdx].cumulative_log_lik;
+	const double minLogLik = std::log(params.prune_likelihood_ratio);
+
+	std::vector<Member> survivors;
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		members[i].cumulative_log_lik -= bestLogLik;
+		if (i != bestIdx && !(members[i].cumulative_log_lik >= minLogLik)) continue;
+		if (i == bestIdx) bestIdx = survivors.size();
+		survivors.push_back(std::move(members[i]));
+	}
+	members = std::move(survivors);
+
+	return bestIdx;
+}
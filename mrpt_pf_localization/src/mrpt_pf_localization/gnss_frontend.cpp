@@ -0,0 +1,136 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#include <mrpt/core/bits_math.h>
+#include <mrpt/topography/conversions.h>  // geodeticToGeocentric_WGS84
+#include <mrpt_pf_localization/gnss_frontend.h>
+
+#include <Eigen/Dense>
+#include <cmath>
+
+namespace
+{
+// WGS84 ellipsoid:
+constexpr double WGS84_A = 6378137.0;  // semi-major axis [m]
+constexpr double WGS84_F = 1.0 / 298.257223563;	 // flattening
+constexpr double WGS84_E2 = WGS84_F * (2.0 - WGS84_F);	// eccentricity^2
+}  // namespace
+
+GnssToMapConverter::GnssToMapConverter(const mp2p_icp::metric_map_t::Georeferencing& georef)
+	: origin_(georef.geo_coord)
+{
+	const double lat0 = mrpt::DEG2RAD(origin_.lat.decimal_value);
+	const double lon0 = mrpt::DEG2RAD(origin_.lon.decimal_value);
+	const double h0 = origin_.height;
+
+	const double sLat = std::sin(lat0), cLat = std::cos(lat0);
+	const double sLon = std::sin(lon0), cLon = std::cos(lon0);
+
+	// ECEF -> ENU rotation at the origin:
+	mrpt::math::CMatrixDouble33 R_enu_ecef;
+	R_enu_ecef(0, 0) = -sLon;
+	R_enu_ecef(0, 1) = cLon;
+	R_enu_ecef(0, 2) = 0;
+	R_enu_ecef(1, 0) = -sLat * cLon;
+	R_enu_ecef(1, 1) = -sLat * sLon;
+	R_enu_ecef(1, 2) = cLat;
+	R_enu_ecef(2, 0) = cLat * cLon;
+	R_enu_ecef(2, 1) = cLat * sLon;
+	R_enu_ecef(2, 2) = sLat;
+
+	mrpt::math::TPoint3D ecef0;
+	mrpt::topography::geodeticToGeocentric_WGS84(origin_, ecef0);
+
+	/* Scheme of transformations:
+	 *
+	 * enu_origin (+) T_enu_to_map = map_xyz_origin
+	 *
+	 * {}^{map}P = {}^{map}T_{enu} {}^{enu}P
+	 */
+	T_map_enu_ = -(georef.T_enu_to_map.mean);
+	R_map_enu_ = T_map_enu_.getRotationMatrix();
+
+	R_map_ecef_.asEigen() = R_map_enu_.asEigen() * R_enu_ecef.asEigen();
+
+	const auto Ro = R_map_ecef_.asEigen() * Eigen::Vector3d(ecef0.x, ecef0.y, ecef0.z);
+	t_map_ecef_.x = T_map_enu_.x() - Ro[0];
+	t_map_ecef_.y = T_map_enu_.y() - Ro[1];
+	t_map_ecef_.z = T_map_enu_.z() - Ro[2];
+
+	// Curvature radii at the origin, for the tangent-plane approximation:
+	const double w = std::sqrt(1.0 - WGS84_E2 * sLat * sLat);
+	const double N = WGS84_A / w;  // prime vertical
+	const double M = WGS84_A * (1.0 - WGS84_E2) / (w * w * w);	// meridian
+
+	east_per_rad_lon_ = (N + h0) * cLat;
+	north_per_rad_lat_ = M + h0;
+	min_curvature_radius_ = std::min(M, N);
+	tan_lat0_ = std::abs(sLat / cLat);
+}
+
+mrpt::math::TPoint3D GnssToMapConverter::to_map(const mrpt::topography::TGeodeticCoords& c) const
+{
+	mrpt::math::TPoint3D ecef;
+	mrpt::topography::geodeticToGeocentric_WGS84(c, ecef);
+
+	const auto& R = R_map_ecef_;
+	return {
+		R(0, 0) * ecef.x + R(0, 1) * ecef.y + R(0, 2) * ecef.z + t_map_ecef_.x,
+		R(1, 0) * ecef.x + R(1, 1) * ecef.y + R(1, 2) * ecef.z + t_map_ecef_.y,
+		R(2, 0) * ecef.x + R(2, 1) * ecef.y + R(2, 2) * ecef.z + t_map_ecef_.z};
+}
+
+mrpt::math::TPoint3D GnssToMapConverter::to_map_tangent_plane(
+	const mrpt::topography::TGeodeticCoords& c) const
+{
+	double dLon = c.lon.decimal_value - origin_.lon.decimal_value;
+	// Handle wrap-around at the antimeridian:
+	if (dLon > 180.0) dLon -= 360.0;
+	if (dLon < -180.0) dLon += 360.0;
+
+	const double dLat = c.lat.decimal_value - origin_.lat.decimal_value;
+
+	const mrpt::math::TPoint3D enu(
+		mrpt::DEG2RAD(dLon) * east_per_rad_lon_, mrpt::DEG2RAD(dLat) * north_per_rad_lat_,
+		c.height - origin_.height);
+
+	return T_map_enu_.composePoint(enu);
+}
+
+double GnssToMapConverter::tangent_plane_error_bound(
+	double horizontal_distance, double height_diff) const
+{
+	// Second order terms neglected by the tangent-plane approximation:
+	// - Earth curvature (vertical drop): d^2/(2R)
+	// - Meridian convergence (east scale change with latitude): d^2 tan(lat)/R
+	// - Scale change with height: d*|dh|/R
+	const double d = horizontal_distance;
+	return (d * d * (0.5 + tan_lat0_) + d * std::abs(height_diff)) / min_curvature_radius_;
+}
+
+mrpt::math::TPoint3D GnssToMapConverter::to_map(
+	const mrpt::topography::TGeodeticCoords& c, double max_error) const
+{
+	const double dLat = mrpt::DEG2RAD(c.lat.decimal_value - origin_.lat.decimal_value);
+	const double dLon = mrpt::DEG2RAD(c.lon.decimal_value - origin_.lon.decimal_value);
+
+	const double dist = std::hypot(dLat * north_per_rad_lat_, dLon * east_per_rad_lon_);
+
+	if (tangent_plane_error_bound(dist, c.height - origin_.height) <= max_error)
+		return to_map_tangent_plane(c);
+	else
+		return to_map(c);
+}
+
+void GnssToMapConverter::to_map(
+	const std::vector<mrpt::topography::TGeodeticCoords>& in,
+	std::vector<mrpt::math::TPoint3D>& out, double max_error) const
+{
+	out.resize(in.size());
+	for (size_t i = 0; i < in.size(); i++) out[i] = to_map(in[i], max_error);
+}
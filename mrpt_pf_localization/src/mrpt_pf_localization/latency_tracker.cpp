@@ -0,0 +1,115 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#include <mrpt/core/exceptions.h>
+#include <mrpt_pf_localization/latency_tracker.h>
+
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram(double bin_width, size_t num_bins)
+	: bin_width_(bin_width), bins_(num_bins + 1, 0)
+{
+	ASSERT_GT_(bin_width, 0);
+	ASSERT_GT_(num_bins, 0U);
+}
+
+void LatencyHistogram::add(double latency)
+{
+	// Negative latencies may happen with unsynchronized clocks: count them in
+	// the first bin, but keep the exact value for the statistics.
+	const size_t nBins = bins_.size() - 1;
+	const double idx = std::floor(std::max(.0, latency) / bin_width_);
+	bins_[idx < nBins ? static_cast<size_t>(idx) : nBins]++;
+
+	if (count_ == 0)
+	{
+		min_ = max_ = latency;
+	}
+	else
+	{
+		min_ = std::min(min_, latency);
+		max_ = std::max(max_, latency);
+	}
+	sum_ += latency;
+	count_++;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+	if (!count_) return 0;
+
+	const auto target = static_cast<uint64_t>(std::ceil(std::clamp(p, .0, 1.0) * count_));
+	uint64_t acc = 0;
+	for (size_t i = 0; i < bins_.size(); i++)
+	{
+		acc += bins_[i];
+		if (acc >= target && acc > 0)
+		{
+			// Upper edge of the bin, never beyond the actual max:
+			return i + 1 < bins_.size() ? std::min(max_, (i + 1) * bin_width_) : max_;
+		}
+	}
+	return max_;
+}
+
+const char* LatencyTracker::stage_name(Stage s)
+{
+	switch (s)
+	{
+		case Stage::Arrival:
+			return "arrival";
+		case Stage::Step:
+			return "step";
+		case Stage::Publish:
+			return "publish";
+	};
+	return "unknown";
+}
+
+void LatencyTracker::add(const std::string& topic, Stage stage, double latency)
+{
+	std::lock_guard<std::mutex> lck(mtx_);
+	histograms_[{topic, stage}].add(latency);
+}
+
+std::map<LatencyTracker::Key, LatencyHistogram> LatencyTracker::snapshot() const
+{
+	std::lock_guard<std::mutex> lck(mtx_);
+	return histograms_;
+}
+
+void LatencyTracker::clear()
+{
+	std::lock_guard<std::mutex> lck(mtx_);
+	histograms_.clear();
+}
+
+void LatencyTracker::write_csv(std::ostream& o, const mrpt::system::CTimeLogger* profiler) const
+{
+	o << "source,name,stage,count,mean_ms,min_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+
+	for (const auto& [key, h] : snapshot())
+	{
+		o << "latency," << key.first << "," << stage_name(key.second) << "," << h.count() << ","
+		  << 1e3 * h.mean() << "," << 1e3 * h.min() << "," << 1e3 * h.percentile(0.5) << ","
+		  << 1e3 * h.percentile(0.9) << "," << 1e3 * h.percentile(0.99) << "," << 1e3 * h.max()
+		  << "\n";
+	}
+
+	if (!profiler) return;
+
+	std::map<std::string, mrpt::system::CTimeLogger::TCallStats> stats;
+	profiler->getStats(stats);
+	for (const auto& [name, st] : stats)
+	{
+		// No percentiles available for profiler sections:
+		o << "profiler," << name << ",," << st.n_calls << "," << 1e3 * st.mean_t << ","
+		  << 1e3 * st.min_t << ",,,," << 1e3 * st.max_t << "\n";
+	}
+}
@@ -15,12 +15,14 @@
 #include <mrpt/maps/COccupancyGridMap2D.h>
 #include <mrpt/maps/CSimplePointsMap.h>
 #include <mrpt/obs/CActionCollection.h>
+#include <mrpt/obs/CObservation2DRangeScan.h>
 #include <mrpt/obs/CObservationPointCloud.h>
 #include <mrpt/opengl/CEllipsoid2D.h>
 #include <mrpt/opengl/CEllipsoid3D.h>
 #include <mrpt/opengl/CPointCloud.h>
 #include <mrpt/random/RandomGenerators.h>
 #include <mrpt/ros2bridge/map.h>
+#include <mrpt/system/CTicTac.h>
 #include <mrpt/system/filesystem.h>
 #include <mrpt/system/hyperlink.h>
 #include <mrpt/topography/conversions.h>  // geodeticToENU_WGS84
@@ -33,6 +35,8 @@
 
 #include <Eigen/Dense>
 #include <chrono>
+#include <limits>
+#include <type_traits>
 
 using mrpt::maps::CSimplePointsMap;
 
@@ -108,6 +112,44 @@ void load_motion_model2d_from(
 	MCP_LOAD_OPT_DEG_HERE(p, additional_std_phi, mmo.thrunModel.additional_std_phi);
 }
 
+/** Builds the map caches that MRPT otherwise builds lazily on the first
+ * likelihood evaluations: KD-trees of point maps, and (if `fillGridCaches`)
+ * the likelihood-field cache of occupancy grids. So they are not built within
+ * the PF steps that follow a map update.
+ */
+void precompute_map_caches(const mrpt::maps::CMultiMetricMap& mm, bool fillGridCaches)
+{
+	for (const auto& m : mm.maps)
+	{
+		if (auto pts = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(m); pts && !pts->empty())
+		{
+			float x, y, z, d2;
+			pts->kdTreeClosestPoint2D(0, 0, x, y, d2);
+			pts->kdTreeClosestPoint3D(0, 0, 0, x, y, z, d2);
+		}
+		else if (auto grid = std::dynamic_pointer_cast<mrpt::maps::COccupancyGridMap2D>(m);
+				 fillGridCaches && grid && grid->likelihoodOptions.enableLikelihoodCache &&
+				 grid->likelihoodOptions.likelihoodMethod ==
+					 mrpt::maps::COccupancyGridMap2D::lmLikelihoodField_Thrun)
+		{
+			// The cache is filled cell by cell as hit points fall on them, so
+			// evaluate a single-point scan that hits each cell:
+			const double r = 0.5;
+			mrpt::obs::CObservation2DRangeScan scan;
+			scan.aperture = 0;
+			scan.maxRange = 2 * r;
+			scan.resizeScan(1);
+			scan.setScanRange(0, static_cast<float>(r));
+			scan.setScanRangeValidity(0, true);
+
+			for (unsigned int cy = 0; cy < grid->getSizeY(); cy++)
+				for (unsigned int cx = 0; cx < grid->getSizeX(); cx++)
+					grid->computeObservationLikelihood(
+						scan, mrpt::poses::CPose2D(grid->idx2x(cx) - r, grid->idx2y(cy), 0));
+		}
+	}
+}
+
 }  // namespace
 
 void PFLocalizationCore::Parameters::load_from(const mrpt::containers::yaml& params)
@@ -242,11 +284,17 @@ void PFLocalizationCore::Parameters::load_from(const mrpt::containers::yaml& par
 		likOpts.loadFromConfigFile(cfg, "");
 	}
 
+	MCP_LOAD_OPT(params, precompute_likelihood_cache);
+
 	//
 	MCP_LOAD_OPT(params, initial_particles_per_m2);
 	MCP_LOAD_OPT(params, initialize_from_gnss);
 	MCP_LOAD_OPT(params, samples_drawn_from_gnss);
 	MCP_LOAD_OPT(params, gnss_samples_num_sigmas);
+	MCP_LOAD_OPT(params, gnss_likelihood_enable);
+	MCP_LOAD_OPT(params, gnss_likelihood_max_age);
+	MCP_LOAD_OPT(params, gnss_likelihood_min_std);
+	MCP_LOAD_OPT(params, gnss_tangent_plane_max_error);
 	MCP_LOAD_OPT(params, relocalize_num_sigmas);
 
 	// relocalization:
@@ -257,6 +305,14 @@ void PFLocalizationCore::Parameters::load_from(const mrpt::containers::yaml& par
 	MCP_LOAD_OPT_DEG(params, relocalization_resolution_phi);
 	MCP_LOAD_OPT(params, relocalization_initial_divisions_xy);
 	MCP_LOAD_OPT(params, relocalization_initial_divisions_phi);
+
+	// filter bank:
+	MCP_LOAD_OPT(params, filter_bank_enable);
+	MCP_LOAD_OPT(params, filter_bank_min_candidate_distance);
+	MCP_LOAD_OPT(params, filter_bank_max_filters);
+	MCP_LOAD_OPT(params, filter_bank_prune_likelihood_ratio);
+	MCP_LOAD_OPT(params, filter_bank_particles_per_member);
+	ASSERT_GT_(filter_bank_particles_per_member, 0U);
 }
 
 struct PFLocalizationCore::InternalState::Relocalization
@@ -275,29 +331,59 @@ PFLocalizationCore::PFLocalizationCore() : mrpt::system::COutputLogger("mrpt_pf_
 
 void PFLocalizationCore::on_observation(const mrpt::obs::CObservation::Ptr& obs)
 {
-	auto tle = mrpt::system::CTimeLoggerEntry(profiler_, "on_observation");
+	auto lck = mrpt::lockHelper(pendingObsMtx_);
+	internal_enqueue_observation(mrpt::obs::CObservation::Ptr(obs));
+}
+
+void PFLocalizationCore::on_observations(const std::vector<mrpt::obs::CObservation::Ptr>& obs)
+{
+	auto lck = mrpt::lockHelper(pendingObsMtx_);
+	state_.pendingObs.reserve(state_.pendingObs.size() + obs.size());
+	for (const auto& o : obs) internal_enqueue_observation(mrpt::obs::CObservation::Ptr(o));
+}
 
+void PFLocalizationCore::on_observations(std::vector<mrpt::obs::CObservation::Ptr>&& obs)
+{
 	auto lck = mrpt::lockHelper(pendingObsMtx_);
-	state_.pendingObs.push_back(obs);
+	state_.pendingObs.reserve(state_.pendingObs.size() + obs.size());
+	for (auto& o : obs) internal_enqueue_observation(std::move(o));
+	obs.clear();
+}
+
+void PFLocalizationCore::internal_enqueue_observation(mrpt::obs::CObservation::Ptr&& obs)
+{
+	if (!obs) return;  // who knows...users may be evil :-)
+
+	// Classify by class ID, cheaper than RTTI dynamic casts:
+	const mrpt::rtti::TRuntimeClassId* cls = obs->GetRuntimeClass();
 
-	if (auto gps = std::dynamic_pointer_cast<mrpt::obs::CObservationGPS>(obs);
-		gps && gps->has_GGA_datum())
+	if (cls == CLASS_ID(mrpt::obs::CObservationOdometry))
+	{
+		state_.pendingObsHasOdometry = true;
+	}
+	else if (cls == CLASS_ID(mrpt::obs::CObservationGPS))
 	{
 		// for the PF, we only care about GPS observations with GGA positioning:
 		// (Note: all NavSatFix msgs are mapped into MRPT GGA GPS messages)
-		last_gnss_ = gps;
+		auto gps = std::static_pointer_cast<mrpt::obs::CObservationGPS>(obs);
+		if (gps->has_GGA_datum())
+		{
+			// Keep a bounded history, in case the PF is not running yet:
+			constexpr size_t MAX_PENDING_GNSS = 256;
+			if (pending_gnss_.size() >= MAX_PENDING_GNSS) pending_gnss_.erase(pending_gnss_.begin());
+			pending_gnss_.push_back(gps);
+
+			last_gnss_ = std::move(gps);
+		}
 	}
+
+	state_.pendingObs.push_back(std::move(obs));
 }
 
 bool PFLocalizationCore::input_queue_has_odometry()
 {
 	auto lck = mrpt::lockHelper(pendingObsMtx_);
-	for (const auto& o : state_.pendingObs)
-	{
-		if (auto oOdo = std::dynamic_pointer_cast<mrpt::obs::CObservationOdometry>(o); oOdo)
-			return true;
-	}
-	return false;
+	return state_.pendingObsHasOdometry;
 }
 
 std::optional<mrpt::Clock::time_point> PFLocalizationCore::input_queue_last_stamp()
@@ -323,6 +409,8 @@ void PFLocalizationCore::step()
 {
 	auto lck = mrpt::lockHelper(stateMtx_);
 
+	state_.lastStepObservations.clear();
+
 	switch (state_.fsm_state)
 	{
 		case State::UNINITIALIZED:
@@ -340,6 +428,13 @@ void PFLocalizationCore::step()
 	}
 }
 
+std::vector<std::pair<std::string, mrpt::Clock::time_point>>
+	PFLocalizationCore::getLastStepObservations()
+{
+	auto lck = mrpt::lockHelper(stateMtx_);
+	return state_.lastStepObservations;
+}
+
 /** Reset the object to the initial state as if created from scratch */
 void PFLocalizationCore::reset()
 {
@@ -407,6 +502,7 @@ void PFLocalizationCore::onStateToBeInitialized()
 	ASSERT_(params_.metric_map);
 	_.metric_map = params_.metric_map;
 	_.georeferencing = params_.georeferencing;
+	if (_.georeferencing) _.gnss_to_map.emplace(*_.georeferencing);
 
 	// Create the 2D or 3D particle filter object:
 	if (params_.use_se3_pf)
@@ -599,12 +695,13 @@ void PFLocalizationCore::onStateRunning()
 	// "observations" for the Bayes filter:
 	mrpt::obs::CSensoryFrame sf;  // sorted, and thread-safe copy of all obs.
 	mrpt::Clock::time_point sfLastTimeStamp;
+	std::vector<mrpt::obs::CObservationGPS::Ptr> gnssFixes;
 	{
 		// If we have multiple observations of the same sensor for this
 		// single PF step, discard all but the latest one. Temporary storage
 		// of observations:
 		std::map<std::string, mrpt::obs::CObservation::Ptr> obsByLabel;
-		std::map<std::string, std::string> obsClassByLabel;
+		std::map<std::string, const mrpt::rtti::TRuntimeClassId*> obsClassByLabel;
 
 		auto lck = mrpt::lockHelper(pendingObsMtx_);
 		for (auto& o : state_.pendingObs)
@@ -612,7 +709,7 @@ void PFLocalizationCore::onStateRunning()
 			if (!o) continue;  // who knows...users may be evil :-)
 			sfLastTimeStamp = o->getTimeStamp();
 
-			const std::string thisObsClass = o->GetRuntimeClass()->className;
+			const mrpt::rtti::TRuntimeClassId* thisObsClass = o->GetRuntimeClass();
 
 			if (auto it = obsClassByLabel.find(o->sensorLabel); it == obsClassByLabel.end())
 			{
@@ -628,13 +725,17 @@ void PFLocalizationCore::onStateRunning()
 						"ERROR: Received two observations with "
 						"sensorLabel='%s' and different classes: '%s' vs "
 						"'%s'",
-						o->sensorLabel.c_str(), it->second.c_str(), thisObsClass.c_str());
+						o->sensorLabel.c_str(), it->second->className, thisObsClass->className);
 				}
 				// All is correct. Update last obs of this type:
 				obsByLabel[o->sensorLabel] = o;
 			}
 		}
 		state_.pendingObs.clear();
+		state_.pendingObsHasOdometry = false;
+
+		gnssFixes = std::move(pending_gnss_);
+		pending_gnss_.clear();
 
 		// Insert the last obs only for each type:
 		for (const auto& kv : obsByLabel) sf.insert(kv.second);
@@ -831,8 +932,6 @@ void PFLocalizationCore::onStateRunning()
 
 		// Create a few particles around each best candidate:
 		ASSERT_(state_.pdf2d);
-		auto& parts = state_.pdf2d->m_particles;
-		parts.clear();
 		mrpt::random::CRandomGenerator rng;
 		const double sigmaXY = params_.relocalization_resolution_xy * 0.33;
 		const double sigmaPhi = params_.relocalization_resolution_phi * 0.33;
@@ -846,16 +945,46 @@ void PFLocalizationCore::onStateRunning()
 			<< reloc.time_cost << " s and gave " << candidates.size()
 			<< " candidates. Particles copies per candidate=" << numCopies);
 
-		for (const auto& pose : candidates)
+		// Group candidates into clusters of nearby poses, one per filter in
+		// the bank. Candidates from GNSS-based initialization also get here,
+		// since they come from the same relocalization:
+		FilterBank::Parameters bankParams;
+		bankParams.min_candidate_distance = params_.filter_bank_min_candidate_distance;
+		bankParams.max_filters = params_.filter_bank_max_filters;
+		bankParams.prune_likelihood_ratio = params_.filter_bank_prune_likelihood_ratio;
+		bankParams.particles_per_member = params_.filter_bank_particles_per_member;
+		state_.filterBank = FilterBank(bankParams);
+
+		std::vector<std::vector<mrpt::math::TPose2D>> clusters;
+		if (params_.filter_bank_enable) clusters = state_.filterBank.cluster_candidates(candidates);
+
+		state_.pdf2d->m_particles.clear();
+
+		if (clusters.size() > 1)
 		{
-			for (size_t i = 0; i < numCopies; i++)
+			// Each member has a fixed particle budget, instead of a number
+			// of copies per candidate:
+			state_.filterBank.create_members(clusters, sigmaXY, sigmaPhi, rng);
+
+			MRPT_LOG_INFO_STREAM(
+				"Filter bank mode: running "
+				<< clusters.size() << " independent filters with a total of "
+				<< state_.filterBank.particle_count() << " particles (instead of "
+				<< candidates.size() * numCopies << ").");
+		}
+		else
+		{
+			for (const auto& pose : candidates)
 			{
-				auto p = pose;
-				p.x += rng.drawGaussian1D(0, sigmaXY);
-				p.y += rng.drawGaussian1D(0, sigmaXY);
-				p.phi += rng.drawGaussian1D(0, sigmaPhi);
-				p.normalizePhi();
-				parts.emplace_back(p, 0.0 /*log weight*/);
+				for (size_t i = 0; i < numCopies; i++)
+				{
+					auto p = pose;
+					p.x += rng.drawGaussian1D(0, sigmaXY);
+					p.y += rng.drawGaussian1D(0, sigmaXY);
+					p.phi += rng.drawGaussian1D(0, sigmaPhi);
+					p.normalizePhi();
+					state_.pdf2d->m_particles.emplace_back(p, 0.0 /*log weight*/);
+				}
 			}
 		}
 
@@ -884,8 +1013,10 @@ void PFLocalizationCore::onStateRunning()
 	}
 
 	// Draw additional helper samples from GNSS readings?
+	// (Not in filter bank mode, where each filter focuses on one candidate)
 	// ----------------------------------------------------
-	if (auto gnssPos = get_gnss_pose_prediction(); gnssPos && params_.samples_drawn_from_gnss > 0)
+	if (auto gnssPos = get_gnss_pose_prediction();
+		gnssPos && params_.samples_drawn_from_gnss > 0 && state_.filterBank.empty())
 	{
 		mrpt::poses::CPoseRandomSampler sampler;
 		sampler.setPosePDF(*gnssPos);
@@ -910,17 +1041,41 @@ void PFLocalizationCore::onStateRunning()
 		}
 	}
 
+	// GNSS fixes to be fused as likelihood observations:
+	// ----------------------------------------------------
+	GnssLikelihoodBatch gnssBatch;
+	if (params_.gnss_likelihood_enable && state_.gnss_to_map && !gnssFixes.empty())
+		gnssBatch = prepare_gnss_likelihood(gnssFixes, sfLastTimeStamp);
+
 	// Process PF
 	// ------------------------
-	mrpt::bayes::CParticleFilterCapable& pfc =
-		state_.pdf2d ? static_cast<mrpt::bayes::CParticleFilterCapable&>(*state_.pdf2d)
-					 : static_cast<mrpt::bayes::CParticleFilterCapable&>(*state_.pdf3d);
+	if (!state_.filterBank.empty())
+	{
+		run_filter_bank_step(actions, sf, gnssBatch);
+	}
+	else
+	{
+		mrpt::bayes::CParticleFilterCapable& pfc =
+			state_.pdf2d ? static_cast<mrpt::bayes::CParticleFilterCapable&>(*state_.pdf2d)
+						 : static_cast<mrpt::bayes::CParticleFilterCapable&>(*state_.pdf3d);
 
-	state_.pf.executeOn(pfc, &actions, &sf, &state_.pf_stats);
+		state_.pf.executeOn(pfc, &actions, &sf, &state_.pf_stats);
+
+		if (!gnssBatch.empty())
+		{
+			if (state_.pdf2d)
+				gnssBatch.update_weights(state_.pdf2d->m_particles);
+			else
+				gnssBatch.update_weights(state_.pdf3d->m_particles);
+			pfc.normalizeWeights();
+		}
+	}
 
 	MRPT_LOG_DEBUG_STREAM(
 		"onStateRunning: executed PF, ESS_beforeResample=" << state_.pf_stats.ESS_beforeResample);
 
+	for (const auto& o : sf) state_.lastStepObservations.emplace_back(o->sensorLabel, o->timestamp);
+
 	// Collect further output stats:
 	// ------------------------------
 	state_.time_last_update = sfLastTimeStamp;
@@ -936,6 +1091,51 @@ void PFLocalizationCore::onStateRunning()
 	if (params_.gui_enable) update_gui(sf);
 }
 
+void PFLocalizationCore::run_filter_bank_step(
+	const mrpt::obs::CActionCollection& actions, const mrpt::obs::CSensoryFrame& sf,
+	const GnssLikelihoodBatch& gnss)
+{
+	auto tle = mrpt::system::CTimeLoggerEntry(profiler_, "run_filter_bank_step");
+
+	auto& bank = state_.filterBank;
+	ASSERT_(!bank.empty());
+	ASSERT_(state_.pdf2d);
+
+	// GNSS fixes are fused into each member, so they also count in the
+	// comparison among members:
+	FilterBank::extra_likelihood_t gnssLikelihood;
+	if (!gnss.empty())
+	{
+		gnssLikelihood = [&gnss](mrpt::slam::CMonteCarloLocalization2D& pdf)
+		{
+			const double logLik = gnss.update_weights(pdf.m_particles);
+			pdf.normalizeWeights();
+			return logLik;
+		};
+	}
+
+	const size_t sizeBefore = bank.size();
+	const size_t bestIdx =
+		bank.step(actions, sf, state_.pdf2d->options, params_.pf_options, gnssLikelihood);
+
+	if (bank.size() != sizeBefore)
+	{
+		MRPT_LOG_INFO_STREAM(
+			"Filter bank: pruned " << sizeBefore - bank.size() << " filters, " << bank.size()
+								   << " remain.");
+	}
+
+	// Expose the winner as the main estimate:
+	*state_.pdf2d = bank.members[bestIdx].pdf;
+	state_.pf_stats = bank.members[bestIdx].pf_stats;
+
+	if (bank.size() == 1)
+	{
+		MRPT_LOG_INFO("Filter bank: only one filter remains, switching to single filter mode.");
+		bank.clear();
+	}
+}
+
 bool PFLocalizationCore::set_map_from_simple_map(
 	const std::string& map_config_ini_file, const std::string& simplemap_file)
 {
@@ -995,24 +1195,38 @@ void PFLocalizationCore::set_map_from_metric_map(
 	const std::optional<mp2p_icp::metric_map_t::Georeferencing>& georeferencing,
 	const std::vector<std::string>& layerNames)
 {
-	auto lck = mrpt::lockHelper(stateMtx_);
-
-	for (const auto& m : metricMap->maps)
+	bool fillGridCaches;
 	{
-		ASSERT_(m);
+		auto lck = mrpt::lockHelper(stateMtx_);
 
-		if (auto pts = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(m);
-			pts && params_.override_likelihood_point_maps)
-		{
-			pts->likelihoodOptions = *params_.override_likelihood_point_maps;
-		}
-		else if (auto occ2D = std::dynamic_pointer_cast<mrpt::maps::COccupancyGridMap2D>(m);
-				 occ2D && params_.override_likelihood_gridmaps)
+		fillGridCaches = params_.precompute_likelihood_cache;
+
+		for (const auto& m : metricMap->maps)
 		{
-			occ2D->likelihoodOptions = *params_.override_likelihood_gridmaps;
+			ASSERT_(m);
+
+			if (auto pts = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(m);
+				pts && params_.override_likelihood_point_maps)
+			{
+				pts->likelihoodOptions = *params_.override_likelihood_point_maps;
+			}
+			else if (auto occ2D = std::dynamic_pointer_cast<mrpt::maps::COccupancyGridMap2D>(m);
+					 occ2D && params_.override_likelihood_gridmaps)
+			{
+				occ2D->likelihoodOptions = *params_.override_likelihood_gridmaps;
+			}
 		}
 	}
 
+	// The new map is not used by the PF yet, so its caches can be built in
+	// the caller thread (e.g. the node map worker) without holding the lock:
+	mrpt::system::CTicTac tictac;
+	precompute_map_caches(*metricMap, fillGridCaches);
+	MRPT_LOG_DEBUG_STREAM(
+		"set_map_from_metric_map: map caches precomputed in " << tictac.Tac() << " s");
+
+	auto lck = mrpt::lockHelper(stateMtx_);
+
 	params_.metric_map = metricMap;
 	params_.georeferencing = georeferencing;
 	params_.metric_map_layer_names = layerNames;
@@ -1359,20 +1573,10 @@ std::optional<mrpt::poses::CPose3DPDFGaussian> PFLocalizationCore::get_gnss_pose
 
 	const auto coords = gga->getAsStruct<mrpt::topography::TGeodeticCoords>();
 
-	/* Scheme of transformations:
-	 *
-	 * enu_origin (+) T_enu_to_map = map_xyz_origin
-	 *
-	 * {}^{map}P_{meas} = {}^{map}T_{enu} {}^{enu}P_{meas}
-	 *
-	 */
-	const auto T_map2enu = -(state_.georeferencing->T_enu_to_map.mean);
-
-	// current GNSS measurement (ENU frame)
-	mrpt::math::TPoint3D P_enu_meas;
-	mrpt::topography::geodeticToENU_WGS84(coords, P_enu_meas, state_.georeferencing->geo_coord);
-
-	const mrpt::math::TPoint3D P_map_meas = T_map2enu.composePoint(P_enu_meas);
+	// current GNSS measurement (map frame):
+	ASSERT_(state_.gnss_to_map);
+	const mrpt::math::TPoint3D P_map_meas =
+		state_.gnss_to_map->to_map(coords, params_.gnss_tangent_plane_max_error);
 
 	mrpt::poses::CPose3DPDFGaussian gnssMeasInMap;
 
@@ -1383,8 +1587,9 @@ std::optional<mrpt::poses::CPose3DPDFGaussian> PFLocalizationCore::get_gnss_pose
 	{
 		const auto& gpsCov = *gps->covariance_enu;
 
-		// XYZ: copy from GPS obs:
-		gnssMeasInMap.cov.block(0, 0, 3, 3) = gpsCov.asEigen();
+		// XYZ: copy from GPS obs, rotated from ENU to the map frame:
+		const auto& R = state_.gnss_to_map->rotation_map_enu().asEigen();
+		gnssMeasInMap.cov.block(0, 0, 3, 3) = R * gpsCov.asEigen() * R.transpose();
 	}
 	else
 	{
@@ -1402,3 +1607,61 @@ std::optional<mrpt::poses::CPose3DPDFGaussian> PFLocalizationCore::get_gnss_pose
 
 	return gnssMeasInMap;
 }
+
+GnssLikelihoodBatch PFLocalizationCore::prepare_gnss_likelihood(
+	const std::vector<mrpt::obs::CObservationGPS::Ptr>& fixes,
+	const mrpt::Clock::time_point& stepStamp)
+{
+	auto tle = mrpt::system::CTimeLoggerEntry(profiler_, "prepare_gnss_likelihood");
+
+	ASSERT_(state_.gnss_to_map);
+
+	// Collect all usable fixes, and convert them to the map frame in one batch:
+	GnssLikelihoodBatch batch;
+	std::vector<mrpt::topography::TGeodeticCoords> coords;
+
+	const auto& R = state_.gnss_to_map->rotation_map_enu().asEigen();
+	const double minVar = mrpt::square(params_.gnss_likelihood_min_std);
+
+	for (const auto& gps : fixes)
+	{
+		if (!gps) continue;
+		if (std::abs(mrpt::system::timeDifference(gps->timestamp, stepStamp)) >
+			params_.gnss_likelihood_max_age)
+			continue;
+
+		const auto gga = gps->getMsgByClassPtr<mrpt::obs::gnss::Message_NMEA_GGA>();
+		if (!gga) continue;
+
+		coords.push_back(gga->getAsStruct<mrpt::topography::TGeodeticCoords>());
+		batch.antenna_on_robot.push_back(gps->sensorPose.translation());
+
+		mrpt::math::CMatrixDouble22 cov;
+		if (gps->covariance_enu.has_value())
+		{
+			const Eigen::Matrix3d covMap =
+				R * gps->covariance_enu->asEigen() * R.transpose();
+			cov.asEigen() = covMap.block<2, 2>(0, 0);
+		}
+		else
+		{
+			cov.setDiagonal(mrpt::square(5.0));	 // Default uncertainty
+		}
+		cov(0, 0) = std::max(cov(0, 0), minVar);
+		cov(1, 1) = std::max(cov(1, 1), minVar);
+
+		batch.info_xy.push_back(cov.inverse_LLt());
+
+		state_.lastStepObservations.emplace_back(gps->sensorLabel, gps->timestamp);
+	}
+
+	if (coords.empty()) return batch;
+
+	state_.gnss_to_map->to_map(coords, batch.meas_in_map, params_.gnss_tangent_plane_max_error);
+
+	MRPT_LOG_DEBUG_STREAM(
+		"prepare_gnss_likelihood: using " << batch.meas_in_map.size() << " out of "
+										  << fixes.size() << " GNSS fixes.");
+
+	return batch;
+}
@@ -9,6 +9,7 @@
 #include "mrpt_pf_localization_node.h"
 
 #include <mp2p_icp/metricmap.h>
+#include <mrpt/core/lock_helper.h>
 #include <mrpt/maps/COccupancyGridMap2D.h>
 #include <mrpt/obs/CObservation2DRangeScan.h>
 #include <mrpt/obs/CObservationBeaconRanges.h>
@@ -31,8 +32,15 @@
 
 #include <geometry_msgs/msg/pose_array.hpp>
 #include <mrpt_msgs_bridge/beacon.hpp>
+#include <sensor_msgs/point_cloud2_iterator.hpp>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.hpp>
 
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <set>
+
 #if MRPT_VERSION >= 0x020b08
 #include <mrpt/system/hyperlink.h>
 #else
@@ -88,22 +96,53 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 	// -----------------
 	reload_params_from_ros();
 
+	// Callback groups, so a long PF step does not delay sensor ingestion or
+	// /tf publication when using a multi-threaded executor:
+	// ------------------------------------------
+	cbGroupSensors_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+	cbGroupLoop_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+	cbGroupOutput_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+	cbGroupMap_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+
+	rclcpp::SubscriptionOptions sensorSubOpts, mapSubOpts;
+	sensorSubOpts.callback_group = cbGroupSensors_;
+	mapSubOpts.callback_group = cbGroupMap_;
+
+	// Intra-process delivery only for the raw sensor data: it cannot be used
+	// with the transient_local durability of the map and /tf_static
+	// subscriptions, which must be kept out even if the node-wide
+	// use_intra_process_comms option is set:
+	auto rawSensorSubOpts = sensorSubOpts;
+	rawSensorSubOpts.use_intra_process_comm = rclcpp::IntraProcessSetting::Enable;
+	mapSubOpts.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+	auto tfStaticSubOpts = sensorSubOpts;
+	tfStaticSubOpts.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+
 	// Create all publishers and subscribers:
 	// ------------------------------------------
 	sub_init_pose_ = this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>(
 		nodeParams_.topic_initialpose, rclcpp::SystemDefaultsQoS(),
-		std::bind(&PFLocalizationNode::callbackInitialpose, this, _1));
+		std::bind(&PFLocalizationNode::callbackInitialpose, this, _1), mapSubOpts);
 
 	// See: REP-2003: https://ros.org/reps/rep-2003.html
 	const auto mapQoS = rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable();
 	const auto sensorQoS = rclcpp::SensorDataQoS();
 
 	subMap_ = this->create_subscription<mrpt_msgs::msg::GenericObject>(
-		nodeParams_.topic_map, mapQoS, std::bind(&PFLocalizationNode::callbackMap, this, _1));
+		nodeParams_.topic_map, mapQoS,
+		[this](mrpt_msgs::msg::GenericObject::UniquePtr msg) { callbackMap(std::move(msg)); },
+		mapSubOpts);
 
 	subOdometry_ = this->create_subscription<nav_msgs::msg::Odometry>(
 		nodeParams_.topic_odometry, rclcpp::SystemDefaultsQoS(),
-		std::bind(&PFLocalizationNode::callbackOdometry, this, _1));
+		std::bind(&PFLocalizationNode::callbackOdometry, this, _1), sensorSubOpts);
+
+	if (nodeParams_.cache_sensor_poses)
+	{
+		subTfStatic_ = this->create_subscription<tf2_msgs::msg::TFMessage>(
+			"/tf_static", tf2_ros::StaticListenerQoS(),
+			std::bind(&PFLocalizationNode::callbackTfStatic, this, _1), tfStaticSubOpts);
+	}
 
 	// Subscribe to one or more sensor sources:
 	size_t numSensors = 0;
@@ -116,8 +155,9 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 			numSensors++;
 			subs_2dlaser_.push_back(this->create_subscription<sensor_msgs::msg::LaserScan>(
 				topic, sensorQoS,
-				[topic, this](const sensor_msgs::msg::LaserScan& msg)
-				{ callbackLaser(msg, topic); }));
+				[topic, this](sensor_msgs::msg::LaserScan::UniquePtr msg)
+				{ callbackLaser(std::move(msg), topic); },
+				rawSensorSubOpts));
 		}
 	}
 	{
@@ -128,8 +168,9 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 			numSensors++;
 			subs_point_clouds_.push_back(this->create_subscription<sensor_msgs::msg::PointCloud2>(
 				topic, sensorQoS,
-				[topic, this](const sensor_msgs::msg::PointCloud2& msg)
-				{ callbackPointCloud(msg, topic); }));
+				[topic, this](sensor_msgs::msg::PointCloud2::UniquePtr msg)
+				{ callbackPointCloud(std::move(msg), topic); },
+				rawSensorSubOpts));
 		}
 	}
 
@@ -143,15 +184,33 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 	// optionally, subscribe to GPS/GNSS:
 	subGNSS_ = this->create_subscription<sensor_msgs::msg::NavSatFix>(
 		nodeParams_.topic_gnss, sensorQoS,
-		[this](const sensor_msgs::msg::NavSatFix& msg) { callbackGNSS(msg); });
+		[this](const sensor_msgs::msg::NavSatFix& msg) { callbackGNSS(msg); }, sensorSubOpts);
 
 	// Publishers:
 	pubParticles_ = this->create_publisher<geometry_msgs::msg::PoseArray>(
 		nodeParams_.pub_topic_particles, rclcpp::SystemDefaultsQoS());
 
+	if (!nodeParams_.pub_topic_particles_cloud.empty())
+	{
+		pubParticlesCloud_ = this->create_publisher<sensor_msgs::msg::PointCloud2>(
+			nodeParams_.pub_topic_particles_cloud, rclcpp::SystemDefaultsQoS());
+	}
+
 	pubPose_ = this->create_publisher<geometry_msgs::msg::PoseWithCovarianceStamped>(
 		nodeParams_.pub_topic_pose, rclcpp::SystemDefaultsQoS());
 
+	if (nodeParams_.latency_tracking_enable && !nodeParams_.pub_topic_diagnostics.empty())
+	{
+		pubDiagnostics_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+			nodeParams_.pub_topic_diagnostics, rclcpp::SystemDefaultsQoS());
+	}
+
+	if (!nodeParams_.pub_topic_fused_pose.empty())
+	{
+		pubFusedPose_ = this->create_publisher<geometry_msgs::msg::PoseWithCovarianceStamped>(
+			nodeParams_.pub_topic_fused_pose, rclcpp::SystemDefaultsQoS());
+	}
+
 #if 0
 		else if (sources[i].find("beacon") != std::string::npos)
 		{
@@ -170,6 +229,10 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 	// Trigger on change -> call:
 #endif
 
+	// Map deserialization worker:
+	// ----------------------------------------
+	mapWorker_ = std::thread([this]() { mapWorkerThread(); });
+
 	// Create the tf2 buffer and listener
 	// ----------------------------------------
 	tf_buffer_ = std::make_shared<tf2_ros::Buffer>(this->get_clock());
@@ -181,7 +244,7 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 	// ------------------------------------------
 	timer_ = this->create_wall_timer(
 		std::chrono::microseconds(mrpt::round(1.0e6 / nodeParams_.rate_hz)),
-		[this]() { this->loop(); });
+		[this]() { this->loop(); }, cbGroupLoop_);
 
 	ASSERT_GT_(nodeParams_.transform_tolerance, 1e-3);
 	timerPubTF_ = this->create_wall_timer(
@@ -190,10 +253,34 @@ PFLocalizationNode::PFLocalizationNode(const rclcpp::NodeOptions& options)
 		{
 			this->publishTF();
 			// publishParticles() && publishPose() are done inside loop()
-		});
+		},
+		cbGroupOutput_);
 }
 
-PFLocalizationNode::~PFLocalizationNode() = default;
+PFLocalizationNode::~PFLocalizationNode()
+{
+	{
+		std::lock_guard<std::mutex> lck(mapWorkerMtx_);
+		mapWorkerQuit_ = true;
+	}
+	mapWorkerCv_.notify_all();
+	if (mapWorker_.joinable()) mapWorker_.join();
+
+	if (!nodeParams_.latency_csv_file.empty())
+	{
+		std::ofstream f(nodeParams_.latency_csv_file);
+		if (f.is_open())
+		{
+			latency_.write_csv(f, &core_.getProfiler());
+		}
+		else
+		{
+			RCLCPP_ERROR(
+				get_logger(), "Could not write latency CSV file: '%s'",
+				nodeParams_.latency_csv_file.c_str());
+		}
+	}
+}
 
 void PFLocalizationNode::reload_params_from_ros()
 {
@@ -273,6 +360,9 @@ void PFLocalizationNode::reload_params_from_ros()
 
 void PFLocalizationNode::loop()
 {
+	// Convert the latest sensor messages, if their conversion was deferred:
+	convertPendingSensorMsgs();
+
 	// Populate PF input with a "fake" odometry from twist estimation
 	// if we have nothing better:
 	createOdometryFromTwist();
@@ -280,6 +370,8 @@ void PFLocalizationNode::loop()
 	// PF algorithm:
 	core_.step();
 
+	const auto stepped = collectSteppedStamps();
+
 	// Estimate twist for the case of not having odometry:
 	updateEstimatedTwist();
 
@@ -289,11 +381,106 @@ void PFLocalizationNode::loop()
 	// /tf data is published in its own timer, save data here in this thread:
 	update_tf_pub_data();
 
-	MRPT_TODO("pub quality metrics");
+	if (nodeParams_.latency_tracking_enable && !stepped.empty())
+	{
+		auto lck = mrpt::lockHelper(tfMapOdomToPublishMtx_);
+		pendingPublishLatency_ = stepped;
+	}
+
+	// Done in this thread, since the core profiler is not thread-safe:
+	publishDiagnostics();
 
 	loopCount_++;  // used to compute decimation for publishing msgs
 }
 
+void PFLocalizationNode::trackArrival(
+	const std::string& topic, const builtin_interfaces::msg::Time& stamp)
+{
+	if (!nodeParams_.latency_tracking_enable) return;
+
+	const auto t = mrpt::ros2bridge::fromROS(stamp);
+	const auto now = mrpt::ros2bridge::fromROS(get_clock()->now());
+	latency_.add(topic, LatencyTracker::Stage::Arrival, mrpt::system::timeDifference(t, now));
+}
+
+std::vector<std::pair<std::string, mrpt::Clock::time_point>>
+	PFLocalizationNode::collectSteppedStamps()
+{
+	std::vector<std::pair<std::string, mrpt::Clock::time_point>> stepped;
+	if (!nodeParams_.latency_tracking_enable) return stepped;
+
+	// Only the observations actually used by the PF, not all received ones:
+	for (const auto& [label, stamp] : core_.getLastStepObservations())
+	{
+		// Sensor labels are topic names, except for odometry and GNSS:
+		const std::string& topic = label == "odom"  ? nodeParams_.topic_odometry
+								   : label == "gps" ? nodeParams_.topic_gnss
+													: label;
+		stepped.emplace_back(topic, stamp);
+	}
+
+	const auto now = mrpt::ros2bridge::fromROS(get_clock()->now());
+	for (const auto& [topic, stamp] : stepped)
+		latency_.add(topic, LatencyTracker::Stage::Step, mrpt::system::timeDifference(stamp, now));
+
+	return stepped;
+}
+
+void PFLocalizationNode::publishDiagnostics()
+{
+	if (!pubDiagnostics_) return;
+
+	const auto now = get_clock()->now();
+	if (lastDiagnosticsPub_ &&
+		(now - *lastDiagnosticsPub_).seconds() < nodeParams_.diagnostics_period)
+		return;
+	lastDiagnosticsPub_ = now;
+
+	const auto toMs = [](double t) { return std::to_string(1e3 * t); };
+	const auto kv = [](const std::string& k, const std::string& v)
+	{
+		diagnostic_msgs::msg::KeyValue e;
+		e.key = k;
+		e.value = v;
+		return e;
+	};
+
+	diagnostic_msgs::msg::DiagnosticArray msg;
+	msg.header.stamp = now;
+
+	for (const auto& [key, h] : latency_.snapshot())
+	{
+		auto& st = msg.status.emplace_back();
+		st.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+		st.name = std::string(get_name()) + ": latency " + key.first + " (" +
+				  LatencyTracker::stage_name(key.second) + ")";
+		st.hardware_id = key.first;
+		st.values.push_back(kv("count", std::to_string(h.count())));
+		st.values.push_back(kv("mean_ms", toMs(h.mean())));
+		st.values.push_back(kv("p50_ms", toMs(h.percentile(0.5))));
+		st.values.push_back(kv("p90_ms", toMs(h.percentile(0.9))));
+		st.values.push_back(kv("p99_ms", toMs(h.percentile(0.99))));
+		st.values.push_back(kv("max_ms", toMs(h.max())));
+	}
+
+	{
+		auto& st = msg.status.emplace_back();
+		st.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+		st.name = std::string(get_name()) + ": profiler";
+
+		std::map<std::string, mrpt::system::CTimeLogger::TCallStats> stats;
+		core_.getProfiler().getStats(stats);
+		for (const auto& [name, cs] : stats)
+		{
+			st.values.push_back(kv(name + ".count", std::to_string(cs.n_calls)));
+			st.values.push_back(kv(name + ".mean_ms", toMs(cs.mean_t)));
+			st.values.push_back(kv(name + ".max_ms", toMs(cs.max_t)));
+		}
+	}
+
+	pubDiagnostics_->publish(msg);
+}
+
 bool PFLocalizationNode::waitForTransform(
 	mrpt::poses::CPose3D& des, const std::string& frame, const std::string& referenceFrame,
 	const int timeoutMilliseconds)
@@ -316,54 +503,184 @@ bool PFLocalizationNode::waitForTransform(
 	}
 	catch (const tf2::TransformException& ex)
 	{
-		RCLCPP_ERROR(get_logger(), "[waitForTransform] %s", ex.what());
+		if (timeoutMilliseconds > 0)
+			RCLCPP_ERROR(get_logger(), "[waitForTransform] %s", ex.what());
+		else
+			RCLCPP_WARN_THROTTLE(
+				get_logger(), *get_clock(), 5000, "[waitForTransform] %s", ex.what());
 		return false;
 	}
 }
 
+bool PFLocalizationNode::getSensorPose(mrpt::poses::CPose3D& des, const std::string& sensorFrame)
+{
+	if (!nodeParams_.cache_sensor_poses)
+		return waitForTransform(des, sensorFrame, nodeParams_.base_link_frame_id);
+
+	{
+		auto lck = mrpt::lockHelper(sensorPosesCacheMtx_);
+		if (auto it = sensorPosesCache_.find(sensorFrame); it != sensorPosesCache_.end())
+		{
+			des = it->second;
+			return true;
+		}
+	}
+
+	// Not cached: non-blocking lookup.
+	if (!waitForTransform(des, sensorFrame, nodeParams_.base_link_frame_id, 0)) return false;
+
+	// Only cache it if it only depends on /tf_static, since transforms in /tf
+	// may change at any time:
+	auto lck = mrpt::lockHelper(sensorPosesCacheMtx_);
+	if (isStaticTransform(sensorFrame, nodeParams_.base_link_frame_id))
+		sensorPosesCache_[sensorFrame] = des;
+	return true;
+}
+
+bool PFLocalizationNode::isStaticTransform(
+	const std::string& frame, const std::string& referenceFrame) const
+{
+	// A frame, and all its ancestors through /tf_static:
+	const auto staticAncestors = [this](const std::string& f)
+	{
+		std::set<std::string> ret = {f};
+		for (auto it = staticTfParents_.find(f); it != staticTfParents_.end();
+			 it = staticTfParents_.find(it->second))
+		{
+			if (!ret.insert(it->second).second) break;	// loop guard
+		}
+		return ret;
+	};
+
+	// Both frames are connected with static transforms only if they share
+	// one static ancestor:
+	const auto a = staticAncestors(frame), b = staticAncestors(referenceFrame);
+	return std::any_of(a.begin(), a.end(), [&b](const auto& f) { return b.count(f) != 0; });
+}
+
+void PFLocalizationNode::callbackTfStatic(const tf2_msgs::msg::TFMessage& msg)
+{
+	auto lck = mrpt::lockHelper(sensorPosesCacheMtx_);
+	for (const auto& t : msg.transforms) staticTfParents_[t.child_frame_id] = t.header.frame_id;
+
+	// Any change in static transforms may affect any cached sensor pose
+	// (e.g. through an intermediary frame), so just start over:
+	if (!sensorPosesCache_.empty())
+	{
+		RCLCPP_DEBUG(get_logger(), "[callbackTfStatic] Invalidating sensor poses cache.");
+		sensorPosesCache_.clear();
+	}
+}
+
 void PFLocalizationNode::callbackLaser(
-	const sensor_msgs::msg::LaserScan& msg, const std::string& topicName)
+	sensor_msgs::msg::LaserScan::UniquePtr msg, const std::string& topicName)
 {
 	RCLCPP_DEBUG(get_logger(), "Received 2D scan (%s)", topicName.c_str());
 
+	trackArrival(topicName, msg->header.stamp);
+
+	set_last_sensor_stamp(mrpt::ros2bridge::fromROS(msg->header.stamp));
+
+	if (nodeParams_.lazy_sensor_conversion)
+	{
+		// Only the latest one per topic will be used by the PF, so defer
+		// conversion until the next loop():
+		auto lck = mrpt::lockHelper(pendingSensorMsgsMtx_);
+		pendingLaserMsgs_[topicName] = std::move(msg);
+		return;
+	}
+
+	if (auto obs = convertLaser(std::move(msg), topicName); obs)
+		core_.on_observation(std::move(obs));
+}
+
+void PFLocalizationNode::callbackPointCloud(
+	sensor_msgs::msg::PointCloud2::UniquePtr msg, const std::string& topicName)
+{
+	RCLCPP_DEBUG(get_logger(), "Received point cloud (%s)", topicName.c_str());
+
+	trackArrival(topicName, msg->header.stamp);
+
+	set_last_sensor_stamp(mrpt::ros2bridge::fromROS(msg->header.stamp));
+
+	if (nodeParams_.lazy_sensor_conversion)
+	{
+		// Only the latest one per topic will be used by the PF, so defer
+		// conversion until the next loop():
+		auto lck = mrpt::lockHelper(pendingSensorMsgsMtx_);
+		pendingPointCloudMsgs_[topicName] = std::move(msg);
+		return;
+	}
+
+	if (auto obs = convertPointCloud(std::move(msg), topicName); obs)
+		core_.on_observation(std::move(obs));
+}
+
+mrpt::obs::CObservation::Ptr PFLocalizationNode::convertLaser(
+	sensor_msgs::msg::LaserScan::UniquePtr msg, const std::string& topicName)
+{
 	// get sensor pose on the robot:
 	mrpt::poses::CPose3D sensorPose;
-	bool sensorPoseOK =
-		waitForTransform(sensorPose, msg.header.frame_id, nodeParams_.base_link_frame_id);
-	if (!sensorPoseOK) return;	// error msg already printed in waitForTransform()
+	bool sensorPoseOK = getSensorPose(sensorPose, msg->header.frame_id);
+	if (!sensorPoseOK) return {};  // error msg already printed in waitForTransform()
 
 	auto obs = mrpt::obs::CObservation2DRangeScan::Create();
-	mrpt::ros2bridge::fromROS(msg, sensorPose, *obs);
+	mrpt::ros2bridge::fromROS(*msg, sensorPose, *obs);
 
-	obs->sensorLabel = topicName;
+	// Release the ROS buffer as soon as possible:
+	msg.reset();
 
-	last_sensor_stamp_ = obs->timestamp;
+	obs->sensorLabel = topicName;
 
-	core_.on_observation(obs);
+	return obs;
 }
 
-void PFLocalizationNode::callbackPointCloud(
-	const sensor_msgs::msg::PointCloud2& msg, const std::string& topicName)
+mrpt::obs::CObservation::Ptr PFLocalizationNode::convertPointCloud(
+	sensor_msgs::msg::PointCloud2::UniquePtr msg, const std::string& topicName)
 {
-	RCLCPP_DEBUG(get_logger(), "Received point cloud (%s)", topicName.c_str());
-
 	// get sensor pose on the robot:
 	mrpt::poses::CPose3D sensorPose;
-	bool sensorPoseOK =
-		waitForTransform(sensorPose, msg.header.frame_id, nodeParams_.base_link_frame_id);
-	if (!sensorPoseOK) return;	// error msg already printed in waitForTransform()
+	bool sensorPoseOK = getSensorPose(sensorPose, msg->header.frame_id);
+	if (!sensorPoseOK) return {};  // error msg already printed in waitForTransform()
 
 	auto obs = mrpt::obs::CObservationPointCloud::Create();
 	obs->sensorLabel = topicName;
+	obs->sensorPose = sensorPose;
+	obs->timestamp = mrpt::ros2bridge::fromROS(msg->header.stamp);
+
+	// Convert straight into the final (SoA) MRPT container. The interleaved
+	// ROS buffer can't be adopted, but it is converted exactly once and
+	// released right away:
 	auto pts = mrpt::maps::CSimplePointsMap::Create();
-	obs->pointcloud = pts;
-	mrpt::ros2bridge::fromROS(msg, *pts);
+	pts->reserve(msg->width * msg->height);
+	mrpt::ros2bridge::fromROS(*msg, *pts);
+	msg.reset();
+	obs->pointcloud = std::move(pts);
 
-	obs->sensorLabel = topicName;
+	return obs;
+}
 
-	last_sensor_stamp_ = obs->timestamp;
+void PFLocalizationNode::convertPendingSensorMsgs()
+{
+	decltype(pendingLaserMsgs_) lasers;
+	decltype(pendingPointCloudMsgs_) clouds;
+	{
+		auto lck = mrpt::lockHelper(pendingSensorMsgsMtx_);
+		lasers.swap(pendingLaserMsgs_);
+		clouds.swap(pendingPointCloudMsgs_);
+	}
+	if (lasers.empty() && clouds.empty()) return;
 
-	core_.on_observation(obs);
+	std::vector<mrpt::obs::CObservation::Ptr> obs;
+	obs.reserve(lasers.size() + clouds.size());
+
+	for (auto& [topic, msg] : lasers)
+		if (auto o = convertLaser(std::move(msg), topic); o) obs.push_back(std::move(o));
+
+	for (auto& [topic, msg] : clouds)
+		if (auto o = convertPointCloud(std::move(msg), topic); o) obs.push_back(std::move(o));
+
+	core_.on_observations(std::move(obs));
 }
 
 void PFLocalizationNode::callbackBeacon(const mrpt_msgs::msg::ObservationRangeBeacon& _msg)
@@ -472,10 +789,45 @@ void PFLocalizationNode::callbackRobotPose(
 #endif
 }
 
-void PFLocalizationNode::callbackMap(const mrpt_msgs::msg::GenericObject& obj)
+void PFLocalizationNode::callbackMap(mrpt_msgs::msg::GenericObject::UniquePtr obj)
 {
 	RCLCPP_INFO(get_logger(), "[callbackMap] Received a metric map via ROS topic");
 
+	// Deserializing a large map may take seconds: hand it over to the
+	// worker thread. If a previous map is still waiting, only the newest
+	// one is kept.
+	{
+		std::lock_guard<std::mutex> lck(mapWorkerMtx_);
+		pendingMapMsg_ = std::move(obj);
+	}
+	mapWorkerCv_.notify_one();
+}
+
+void PFLocalizationNode::mapWorkerThread()
+{
+	for (;;)
+	{
+		mrpt_msgs::msg::GenericObject::UniquePtr msg;
+		{
+			std::unique_lock<std::mutex> lck(mapWorkerMtx_);
+			mapWorkerCv_.wait(lck, [this]() { return mapWorkerQuit_ || pendingMapMsg_; });
+			if (mapWorkerQuit_) return;
+			msg = std::move(pendingMapMsg_);
+		}
+
+		try
+		{
+			processMapMsg(*msg);
+		}
+		catch (const std::exception& e)
+		{
+			RCLCPP_ERROR_STREAM(get_logger(), "[mapWorkerThread] Error processing map:\n" << e.what());
+		}
+	}
+}
+
+void PFLocalizationNode::processMapMsg(const mrpt_msgs::msg::GenericObject& obj)
+{
 	mrpt::serialization::CSerializable::Ptr o;
 	mrpt::serialization::OctetVectorToObject(obj.data, o);
 
@@ -487,8 +839,9 @@ void PFLocalizationNode::callbackMap(const mrpt_msgs::msg::GenericObject& obj)
 				"is '%s'",
 				o->GetRuntimeClass()->className));
 
-	RCLCPP_INFO_STREAM(get_logger(), "[callbackMap] Map contents: " << mm->contents_summary());
+	RCLCPP_INFO_STREAM(get_logger(), "[processMapMsg] Map contents: " << mm->contents_summary());
 
+	// The PF only switches to the new map here, once it is fully ready:
 	core_.set_map_from_metric_map(*mm);
 }
 
@@ -507,6 +860,8 @@ void PFLocalizationNode::callbackInitialpose(
 
 void PFLocalizationNode::callbackOdometry(const nav_msgs::msg::Odometry& msg)
 {
+	trackArrival(nodeParams_.topic_odometry, msg.header.stamp);
+
 	auto obs = mrpt::obs::CObservationOdometry::Create();
 	obs->timestamp = mrpt::ros2bridge::fromROS(msg.header.stamp);
 	obs->sensorLabel = "odom";
@@ -518,19 +873,60 @@ void PFLocalizationNode::callbackOdometry(const nav_msgs::msg::Odometry& msg)
 	// SE(3) -> SE(2):
 	obs->odometry = mrpt::poses::CPose2D(mrpt::ros2bridge::fromROS(msg.pose.pose));
 
-	last_sensor_stamp_ = obs->timestamp;
+	set_last_sensor_stamp(obs->timestamp);
 
 	core_.on_observation(obs);
+
+	if (pubFusedPose_) publishFusedPose(msg);
+}
+
+void PFLocalizationNode::publishFusedPose(const nav_msgs::msg::Odometry& odom)
+{
+	// Only the node-side copy of the last correction is used here, so this
+	// never waits for the PF core:
+	std::optional<geometry_msgs::msg::PoseWithCovariance> correction;
+	std::array<double, 36> odomCovAtCorrection;
+	{
+		auto lck = mrpt::lockHelper(tfMapOdomToPublishMtx_);
+		lastOdomCov_ = odom.pose.covariance;
+		correction = mapOdomCorrection_;
+		odomCovAtCorrection = odomCovAtCorrection_;
+	}
+	if (!correction) return;  // No PF solution yet
+	if (pubFusedPose_->get_subscription_count() == 0) return;
+
+	// The PF estimate already accounts for the odometry drift up to the
+	// correction, so only the odometry uncertainty accumulated since then is
+	// added. Odometry covariances grow over time; if they do not (e.g. an
+	// odometry reset), fall back to the full one as an upper bound:
+	geometry_msgs::msg::PoseWithCovariance odomIncr = odom.pose;
+	bool covGrew = true;
+	for (size_t i = 0; i < 6; i++)
+		covGrew = covGrew && odom.pose.covariance[i * 7] >= odomCovAtCorrection[i * 7];
+	if (covGrew)
+		for (size_t i = 0; i < odomIncr.covariance.size(); i++)
+			odomIncr.covariance[i] -= odomCovAtCorrection[i];
+
+	geometry_msgs::msg::PoseWithCovarianceStamped p;
+	p.header.frame_id = nodeParams_.global_frame_id;
+	p.header.stamp = odom.header.stamp;
+
+	// map->base_link = map->odom (+) odom->base_link, with first-order
+	// covariance propagation:
+	pose_cov_ops::compose(*correction, odomIncr, p.pose);
+
+	pubFusedPose_->publish(p);
 }
 
 void PFLocalizationNode::callbackGNSS(const sensor_msgs::msg::NavSatFix& msg)
 {
 	RCLCPP_DEBUG_STREAM(get_logger(), "Received GNSS observation");
 
+	trackArrival(nodeParams_.topic_gnss, msg.header.stamp);
+
 	// get sensor pose on the robot:
 	mrpt::poses::CPose3D sensorPose;
-	bool sensorPoseOK =
-		waitForTransform(sensorPose, msg.header.frame_id, nodeParams_.base_link_frame_id);
+	bool sensorPoseOK = getSensorPose(sensorPose, msg.header.frame_id);
 	if (!sensorPoseOK) return;	// error msg already printed in waitForTransform()
 
 	auto obs = mrpt::obs::CObservationGPS::Create();
@@ -547,11 +943,61 @@ void PFLocalizationNode::callbackGNSS(const sensor_msgs::msg::NavSatFix& msg)
 	// Only count this as sensor timestamp if it's the first one for
 	// initialization, so we have a valid stamp to publish the first set of
 	// particles:
-	if (!last_sensor_stamp_) last_sensor_stamp_ = obs->timestamp;
+	if (!get_last_sensor_stamp()) set_last_sensor_stamp(obs->timestamp);
 
 	core_.on_observation(obs);
 }
 
+std::vector<size_t> PFLocalizationNode::selectParticlesToPublish(
+	const mrpt::poses::CPose3DPDFParticles& parts) const
+{
+	const size_t N = parts.size();
+	const size_t K = nodeParams_.particles_max_published;
+
+	std::vector<size_t> idxs;
+	if (K == 0 || N <= K)
+	{
+		idxs.resize(N);
+		std::iota(idxs.begin(), idxs.end(), 0);
+		return idxs;
+	}
+
+	if (nodeParams_.particles_decimation_method == "top_k")
+	{
+		idxs.resize(N);
+		std::iota(idxs.begin(), idxs.end(), 0);
+		std::partial_sort(
+			idxs.begin(), idxs.begin() + K, idxs.end(), [&](size_t a, size_t b)
+			{ return parts.m_particles[a].log_w > parts.m_particles[b].log_w; });
+		idxs.resize(K);
+		return idxs;
+	}
+
+	// "systematic": K evenly spaced samples over the cumulative weights, so
+	// the published subset keeps the shape of the distribution:
+	double maxLogW = -std::numeric_limits<double>::max();
+	for (const auto& part : parts.m_particles) mrpt::keep_max(maxLogW, part.log_w);
+
+	std::vector<double> cumW(N);
+	double sumW = 0;
+	for (size_t i = 0; i < N; i++)
+	{
+		sumW += std::exp(parts.m_particles[i].log_w - maxLogW);
+		cumW[i] = sumW;
+	}
+
+	idxs.reserve(K);
+	const double step = sumW / K;
+	size_t j = 0;
+	for (size_t k = 0; k < K; k++)
+	{
+		const double u = (k + 0.5) * step;
+		while (j + 1 < N && cumW[j] < u) j++;
+		if (idxs.empty() || idxs.back() != j) idxs.push_back(j);
+	}
+	return idxs;
+}
+
 void PFLocalizationNode::publishParticlesAndStampedPose()
 {
 	const mrpt::poses::CPose3DPDFParticles::Ptr parts = core_.getLastPoseEstimation();
@@ -562,31 +1008,65 @@ void PFLocalizationNode::publishParticlesAndStampedPose()
 		return;
 	}
 
-	if (!last_sensor_stamp_.has_value()) return;
+	const auto lastSensorStamp = get_last_sensor_stamp();
+	if (!lastSensorStamp.has_value()) return;
 
-	const auto stamp = mrpt::ros2bridge::toROS(*last_sensor_stamp_);
+	const auto stamp = mrpt::ros2bridge::toROS(*lastSensorStamp);
 
 	// publish particles:
-	if (pubParticles_->get_subscription_count())
+	const bool pubArray = pubParticles_->get_subscription_count() != 0;
+	const bool pubCloud = pubParticlesCloud_ && pubParticlesCloud_->get_subscription_count() != 0;
+
+	if (pubArray || pubCloud)
 	{
-		geometry_msgs::msg::PoseArray poseArray;
-		poseArray.header.frame_id = nodeParams_.global_frame_id;
-		poseArray.header.stamp = stamp;
+		const auto idxs = selectParticlesToPublish(*parts);
 
-		if (!parts)
-		{  // no solution yet
-			poseArray.poses.resize(0);
-		}
-		else
+		if (pubArray)
 		{
-			poseArray.poses.resize(parts->size());
-			for (size_t i = 0; i < parts->size(); i++)
+			geometry_msgs::msg::PoseArray poseArray;
+			poseArray.header.frame_id = nodeParams_.global_frame_id;
+			poseArray.header.stamp = stamp;
+
+			poseArray.poses.resize(idxs.size());
+			for (size_t i = 0; i < idxs.size(); i++)
 			{
-				const auto p = parts->getParticlePose(i);
+				const auto p = parts->getParticlePose(idxs[i]);
 				poseArray.poses[i] = mrpt::ros2bridge::toROS_Pose(p);
 			}
+			pubParticles_->publish(poseArray);
+		}
+
+		if (pubCloud)
+		{
+			// Compact encoding: 4 floats per particle (x, y, yaw, weight):
+			auto msg = std::make_unique<sensor_msgs::msg::PointCloud2>();
+			msg->header.frame_id = nodeParams_.global_frame_id;
+			msg->header.stamp = stamp;
+
+			sensor_msgs::PointCloud2Modifier mod(*msg);
+			mod.setPointCloud2Fields(
+				4, "x", 1, sensor_msgs::msg::PointField::FLOAT32,  //
+				"y", 1, sensor_msgs::msg::PointField::FLOAT32,	//
+				"yaw", 1, sensor_msgs::msg::PointField::FLOAT32,  //
+				"weight", 1, sensor_msgs::msg::PointField::FLOAT32);
+			mod.resize(idxs.size());
+
+			double maxLogW = -std::numeric_limits<double>::max();
+			for (const auto& part : parts->m_particles) mrpt::keep_max(maxLogW, part.log_w);
+
+			sensor_msgs::PointCloud2Iterator<float> itX(*msg, "x"), itY(*msg, "y"),
+				itYaw(*msg, "yaw"), itW(*msg, "weight");
+			for (const size_t i : idxs)
+			{
+				const auto& part = parts->m_particles[i];
+				*itX = static_cast<float>(part.d.x);
+				*itY = static_cast<float>(part.d.y);
+				*itYaw = static_cast<float>(part.d.yaw);
+				*itW = static_cast<float>(std::exp(part.log_w - maxLogW));
+				++itX, ++itY, ++itYaw, ++itW;
+			}
+			pubParticlesCloud_->publish(std::move(msg));
 		}
-		pubParticles_->publish(poseArray);
 	}
 
 	if (pubPose_->get_subscription_count())
@@ -616,7 +1096,8 @@ void PFLocalizationNode::update_tf_pub_data()
 
 	const auto posePdf = core_.getLastPoseEstimation();
 	if (!posePdf) return;  // No solution yet.
-	if (!last_sensor_stamp_) return;
+	const auto lastSensorStamp = get_last_sensor_stamp();
+	if (!lastSensorStamp) return;
 
 	const auto estimatedPose = posePdf->getMeanVal();
 
@@ -642,15 +1123,31 @@ void PFLocalizationNode::update_tf_pub_data()
 	const auto tf_tolerance = tf2::durationFromSec(nodeParams_.transform_tolerance);
 
 	tf2::TimePoint transform_expiration =
-		tf2_ros::fromMsg(mrpt::ros2bridge::toROS(*last_sensor_stamp_)) + tf_tolerance;
+		tf2_ros::fromMsg(mrpt::ros2bridge::toROS(*lastSensorStamp)) + tf_tolerance;
 
 	tf2::Stamped<tf2::Transform> tmp_tf_stamped(
 		baseOnMap_tf * odomOnBase_tf, transform_expiration, global_frame_id);
 
+	// map->odom correction with uncertainty, for the high-rate fused pose:
+	std::optional<geometry_msgs::msg::PoseWithCovariance> correction;
+	if (pubFusedPose_)
+	{
+		mrpt::poses::CPose3DPDFGaussian T_map_odom;
+		T_map_odom.copyFrom(*posePdf);
+		T_map_odom += T_base_to_odom;
+		correction = mrpt::ros2bridge::toROS_Pose(T_map_odom);
+	}
+
 	auto lck = mrpt::lockHelper(tfMapOdomToPublishMtx_);
 
 	tfMapOdomToPublish_ = tf2::toMsg(tmp_tf_stamped);
 	tfMapOdomToPublish_->child_frame_id = odom_frame_id;
+
+	if (correction)
+	{
+		mapOdomCorrection_ = std::move(correction);
+		odomCovAtCorrection_ = lastOdomCov_;
+	}
 }
 
 void PFLocalizationNode::publishTF()
@@ -661,6 +1158,16 @@ void PFLocalizationNode::publishTF()
 
 	tf_broadcaster_->sendTransform(*tfMapOdomToPublish_);
 
+	// First publication of a new PF result?
+	if (!pendingPublishLatency_.empty())
+	{
+		const auto now = mrpt::ros2bridge::fromROS(get_clock()->now());
+		for (const auto& [topic, stamp] : pendingPublishLatency_)
+			latency_.add(
+				topic, LatencyTracker::Stage::Publish, mrpt::system::timeDifference(stamp, now));
+		pendingPublishLatency_.clear();
+	}
+
 	const auto tf_tolerance_1_2 = tf2::durationFromSec(0.5 * nodeParams_.transform_tolerance);
 
 	RCLCPP_DEBUG_STREAM(
@@ -712,10 +1219,25 @@ void PFLocalizationNode::NodeParameters::loadFrom(const mrpt::containers::yaml&
 
 	MCP_LOAD_OPT(cfg, pub_topic_particles);
 	MCP_LOAD_OPT(cfg, pub_topic_pose);
+	MCP_LOAD_OPT(cfg, pub_topic_fused_pose);
+	MCP_LOAD_OPT(cfg, pub_topic_particles_cloud);
+	MCP_LOAD_OPT(cfg, particles_max_published);
+	MCP_LOAD_OPT(cfg, particles_decimation_method);
+	ASSERTMSG_(
+		particles_decimation_method == "top_k" || particles_decimation_method == "systematic",
+		"particles_decimation_method must be either 'top_k' or 'systematic'");
+
+	MCP_LOAD_OPT(cfg, latency_tracking_enable);
+	MCP_LOAD_OPT(cfg, pub_topic_diagnostics);
+	MCP_LOAD_OPT(cfg, diagnostics_period);
+	MCP_LOAD_OPT(cfg, latency_csv_file);
 
 	MCP_LOAD_OPT(cfg, topic_sensors_2d_scan);
 	MCP_LOAD_OPT(cfg, topic_sensors_point_clouds);
 	MCP_LOAD_OPT(cfg, topic_gnss);
+
+	MCP_LOAD_OPT(cfg, cache_sensor_poses);
+	MCP_LOAD_OPT(cfg, lazy_sensor_conversion);
 }
 
 void PFLocalizationNode::updateEstimatedTwist()
@@ -725,9 +1247,10 @@ void PFLocalizationNode::updateEstimatedTwist()
 	// No solution yet
 	if (!parts) return;
 
-	if (!last_sensor_stamp_) return;
+	const auto lastSensorStamp = get_last_sensor_stamp();
+	if (!lastSensorStamp) return;
 
-	const auto curStamp = *last_sensor_stamp_;
+	const auto curStamp = *lastSensorStamp;
 
 	// estimate twist:
 	if (!prevParts_)
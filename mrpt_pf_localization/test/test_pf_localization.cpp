@@ -11,11 +11,21 @@
 #include <mp2p_icp_filters/Generator.h>
 #include <mrpt/containers/yaml.h>
 #include <mrpt/core/get_env.h>
+#include <mrpt/maps/COccupancyGridMap2D.h>
+#include <mrpt/obs/CActionCollection.h>
+#include <mrpt/obs/CActionRobotMovement2D.h>
+#include <mrpt/obs/CObservation2DRangeScan.h>
 #include <mrpt/obs/CObservation3DRangeScan.h>
 #include <mrpt/obs/CObservationPointCloud.h>
 #include <mrpt/obs/CRawlog.h>
+#include <mrpt/random/RandomGenerators.h>
+#include <mrpt/topography/conversions.h>
+#include <mrpt_pf_localization/filter_bank.h>
+#include <mrpt_pf_localization/gnss_frontend.h>
+#include <mrpt_pf_localization/latency_tracker.h>
 #include <mrpt_pf_localization/mrpt_pf_localization_core.h>
 
+#include <sstream>
 #include <thread>
 
 struct TestParams
@@ -70,6 +80,228 @@ TEST(PF_Localization, InitState)
 	}
 }
 
+TEST(PF_Localization, BatchObservations)
+{
+	PFLocalizationCore loc;
+
+	EXPECT_FALSE(loc.input_queue_has_odometry());
+	EXPECT_FALSE(loc.input_queue_last_stamp().has_value());
+
+	const auto t0 = mrpt::Clock::now();
+
+	std::vector<mrpt::obs::CObservation::Ptr> batch;
+	for (int i = 0; i < 5; i++)
+	{
+		auto pc = mrpt::obs::CObservationPointCloud::Create();
+		pc->sensorLabel = "lidar";
+		pc->timestamp = t0 + std::chrono::milliseconds(100 * (i + 1));
+		batch.push_back(pc);
+	}
+	batch.push_back(nullptr);  // must be silently ignored
+
+	loc.on_observations(std::move(batch));
+	EXPECT_TRUE(batch.empty());
+	EXPECT_FALSE(loc.input_queue_has_odometry());
+
+	auto odo = mrpt::obs::CObservationOdometry::Create();
+	odo->sensorLabel = "odom";
+	odo->timestamp = t0;
+	loc.on_observations({odo});
+
+	EXPECT_TRUE(loc.input_queue_has_odometry());
+	ASSERT_TRUE(loc.input_queue_last_stamp().has_value());
+	EXPECT_EQ(*loc.input_queue_last_stamp(), t0);
+}
+
+TEST(PF_Localization, GnssToMapConverter)
+{
+	mp2p_icp::metric_map_t::Georeferencing georef;
+	georef.geo_coord.lat = 36.8383;
+	georef.geo_coord.lon = -2.4597;
+	georef.geo_coord.height = 100.0;
+	georef.T_enu_to_map.mean = mrpt::poses::CPose3D::FromXYZYawPitchRoll(10.0, -5.0, 1.0, 0.3, 0, 0);
+
+	const GnssToMapConverter conv(georef);
+	const auto T_map_enu = -georef.T_enu_to_map.mean;
+
+	for (const double dist : {0.0, 10.0, 100.0, 1000.0, 10000.0})
+	{
+		mrpt::topography::TGeodeticCoords c = georef.geo_coord;
+		c.lat = c.lat.decimal_value + dist / 111e3;
+		c.lon = c.lon.decimal_value + dist / 89e3;
+		c.height = c.height + 0.01 * dist;
+
+		// Reference: the generic ENU conversion:
+		mrpt::math::TPoint3D enu;
+		mrpt::topography::geodeticToENU_WGS84(c, enu, georef.geo_coord);
+		const auto expected = T_map_enu.composePoint(enu);
+
+		EXPECT_NEAR((conv.to_map(c) - expected).norm(), 0.0, 1e-4) << "dist=" << dist;
+
+		// The tangent-plane approximation must be within its bound:
+		const auto approx = conv.to_map_tangent_plane(c);
+		const auto enuApprox = T_map_enu.inverseComposePoint(approx);
+		const double bound = conv.tangent_plane_error_bound(
+			mrpt::math::TPoint2D(enuApprox.x, enuApprox.y).norm(), enuApprox.z);
+
+		EXPECT_LE((approx - expected).norm(), bound + 1e-4) << "dist=" << dist;
+
+		// The automatic choice must honor the requested max error:
+		EXPECT_LE((conv.to_map(c, 0.01) - expected).norm(), 0.01 + 1e-4) << "dist=" << dist;
+	}
+}
+
+TEST(PF_Localization, LatencyTracker)
+{
+	LatencyHistogram h(1e-3 /*bin width*/, 1000 /*bins*/);
+	for (int i = 1; i <= 100; i++) h.add(i * 1e-3);
+
+	EXPECT_EQ(h.count(), 100U);
+	EXPECT_NEAR(h.mean(), 50.5e-3, 1e-9);
+	EXPECT_NEAR(h.min(), 1e-3, 1e-9);
+	EXPECT_NEAR(h.percentile(0.5), 50e-3, 1.5e-3);
+	EXPECT_NEAR(h.percentile(0.9), 90e-3, 1.5e-3);
+	EXPECT_NEAR(h.percentile(1.0), 100e-3, 1e-9);
+
+	// Overflow values keep exact max:
+	h.add(5.0);
+	EXPECT_NEAR(h.percentile(1.0), 5.0, 1e-9);
+
+	LatencyTracker t;
+	t.add("/scan", LatencyTracker::Stage::Arrival, 0.01);
+	t.add("/scan", LatencyTracker::Stage::Publish, 0.2);
+	EXPECT_EQ(t.snapshot().size(), 2U);
+
+	std::stringstream ss;
+	t.write_csv(ss);
+	EXPECT_NE(ss.str().find("latency,/scan,publish,1,200"), std::string::npos) << ss.str();
+}
+
+TEST(PF_Localization, FilterBank)
+{
+	using mrpt::math::TPose2D;
+
+	// A room with a few asymmetric obstacles:
+	auto grid = mrpt::maps::COccupancyGridMap2D::Create(-10.0f, 10.0f, -10.0f, 10.0f, 0.05f);
+	grid->fill(1.0f);
+	for (double t = -8.0; t <= 8.0; t += 0.02)
+	{
+		grid->setPos(t, -6.0, 0.0f);
+		grid->setPos(t, 6.0, 0.0f);
+		if (t >= -6.0 && t <= 6.0)
+		{
+			grid->setPos(-8.0, t, 0.0f);
+			grid->setPos(8.0, t, 0.0f);
+		}
+		if (t >= 2.0 && t <= 4.0) grid->setPos(3.0, t, 0.0f);
+		if (t >= -6.0 && t <= -1.0) grid->setPos(-5.0, t, 0.0f);
+	}
+
+	const TPose2D truePose(1.0, -1.0, 0.3), wrongPose(-4.0, 3.0, -1.2);
+
+	mrpt::obs::CObservation2DRangeScan scan;
+	scan.aperture = 1.5 * M_PI;
+	scan.maxRange = 15.0;
+	grid->laserScanSimulator(scan, mrpt::poses::CPose2D(truePose), 0.6f, 181);
+
+	mrpt::obs::CSensoryFrame sf;
+	sf.insert(std::make_shared<mrpt::obs::CObservation2DRangeScan>(scan));
+
+	mrpt::obs::CActionRobotMovement2D::TMotionModelOptions motionOpts;
+	motionOpts.modelSelection = mrpt::obs::CActionRobotMovement2D::mmGaussian;
+	motionOpts.gaussianModel.minStdXY = 0.02;
+	motionOpts.gaussianModel.minStdPHI = mrpt::DEG2RAD(1.0);
+	mrpt::obs::CActionRobotMovement2D odoIncr;
+	odoIncr.computeFromOdometry(mrpt::poses::CPose2D(0, 0, 0), motionOpts);
+	mrpt::obs::CActionCollection actions;
+	actions.insert(odoIncr);
+
+	mrpt::slam::TMonteCarloLocalizationParams pdfOpts;
+	pdfOpts.metricMap = grid;
+	const mrpt::bayes::CParticleFilter::TParticleFilterOptions pfOpts;
+
+	mrpt::random::CRandomGenerator rng;
+	rng.randomize(123);
+	const auto makeBank = [&](const std::vector<TPose2D>& seeds)
+	{
+		FilterBank::Parameters bp;
+		bp.particles_per_member = 100;
+		FilterBank bank(bp);
+		bank.create_members(bank.cluster_candidates(seeds), 0.1, 0.05, rng);
+		return bank;
+	};
+
+	// Candidates closer than min_candidate_distance share a member:
+	{
+		FilterBank bank;
+		const auto clusters =
+			bank.cluster_candidates({truePose, TPose2D(1.5, -1.0, 0.0), wrongPose});
+		ASSERT_EQ(clusters.size(), 2U);
+		EXPECT_EQ(clusters[0].size(), 2U);
+	}
+
+	// Each member has a fixed particle budget, so the bank has far fewer
+	// particles than copies of all candidates in a single particle set:
+	{
+		std::vector<TPose2D> candidates;
+		for (const auto& c : {truePose, wrongPose, TPose2D(6.0, 4.0, 0), TPose2D(-6.0, -4.0, 0)})
+			for (int ix = -2; ix <= 2; ix++)
+				for (int iy = -2; iy <= 2; iy++)
+					candidates.emplace_back(c.x + 0.25 * ix, c.y + 0.25 * iy, c.phi);
+
+		FilterBank bank;
+		bank.create_members(bank.cluster_candidates(candidates), 0.1, 0.05, rng);
+		ASSERT_EQ(bank.size(), 4U);
+		EXPECT_EQ(bank.particle_count(), 4U * bank.params.particles_per_member);
+
+		const PFLocalizationCore::Parameters p;
+		EXPECT_LT(
+			bank.particle_count(),
+			candidates.size() * p.relocalization_min_sample_copies_per_candidate);
+	}
+
+	// The member at the wrong pose must be pruned by the scan likelihood:
+	{
+		auto bank = makeBank({wrongPose, truePose});
+		ASSERT_EQ(bank.size(), 2U);
+
+		size_t best = 0;
+		for (int i = 0; i < 5 && bank.size() > 1; i++)
+			best = bank.step(actions, sf, pdfOpts, pfOpts);
+
+		ASSERT_EQ(bank.size(), 1U);
+		const auto mean = bank.members[best].pdf.getMeanVal();
+		EXPECT_NEAR(mean.x(), truePose.x, 0.2);
+		EXPECT_NEAR(mean.y(), truePose.y, 0.2);
+	}
+
+	// Without scans, only the GNSS fixes, fused into each member, tell them
+	// apart:
+	{
+		auto bank = makeBank({truePose, wrongPose});
+
+		GnssLikelihoodBatch gnss;
+		gnss.meas_in_map.emplace_back(wrongPose.x, wrongPose.y, 0);
+		gnss.antenna_on_robot.emplace_back(0, 0, 0);
+		gnss.info_xy.push_back(mrpt::math::CMatrixDouble22::Identity());
+
+		const auto gnssLikelihood = [&gnss](mrpt::slam::CMonteCarloLocalization2D& pdf)
+		{
+			const double logLik = gnss.update_weights(pdf.m_particles);
+			pdf.normalizeWeights();
+			return logLik;
+		};
+
+		const size_t best =
+			bank.step(actions, mrpt::obs::CSensoryFrame(), pdfOpts, pfOpts, gnssLikelihood);
+
+		ASSERT_EQ(bank.size(), 1U);
+		const auto mean = bank.members[best].pdf.getMeanVal();
+		EXPECT_NEAR(mean.x(), wrongPose.x, 0.2);
+		EXPECT_NEAR(mean.y(), wrongPose.y, 0.2);
+	}
+}
+
 TEST(PF_Localization, RunRealDataset)
 {
 	TestParams _;
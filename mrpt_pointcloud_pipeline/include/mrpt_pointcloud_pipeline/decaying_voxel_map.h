@@ -0,0 +1,179 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/core/exceptions.h>
+#include <mrpt/math/TPoint3D.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <unordered_map>
+
+/**
+ * Sparse voxel map of obstacles with a limited memory in time.
+ *
+ * Each occupied voxel keeps the timestamp it was last seen, and the number of
+ * times it was seen. New observations first clear (ray-cast) the voxels
+ * between the sensor and each point, then mark the voxel of each point.
+ * Voxels not seen for longer than `ttl` seconds are removed by decay().
+ */
+class DecayingVoxelMap
+{
+   public:
+	struct Parameters
+	{
+		double voxel_size = 0.10;  //!< [m]
+		double ttl = 5.0;  //!< Time to live of unobserved voxels [s]
+		/// Voxels seen less than this number of times are not returned by
+		/// get_voxels(), to filter out noise.
+		uint32_t min_hits = 1;
+		bool ray_clearing = true;
+		/// Rays are only cleared up to this distance from the sensor [m].
+		double max_ray_length = 10.0;
+	};
+
+	Parameters params;
+
+	struct Voxel
+	{
+		double last_seen = 0;
+		uint32_t hits = 0;
+	};
+
+	size_t size() const { return voxels_.size(); }
+	void clear() { voxels_.clear(); }
+
+	/** Inserts one observation: `sensor` is the sensor position, and the
+	 * points (xs,ys,zs) are given in the same (world) frame. */
+	template <typename VEC>
+	void insert(const mrpt::math::TPoint3D& sensor, const VEC& xs, const VEC& ys, const VEC& zs,
+				double stamp)
+	{
+		ASSERT_EQUAL_(xs.size(), ys.size());
+		ASSERT_EQUAL_(xs.size(), zs.size());
+		ASSERT_GT_(params.voxel_size, 0);
+
+		if (params.ray_clearing && !voxels_.empty())
+		{
+			for (size_t i = 0; i < xs.size(); i++)
+				clear_ray(sensor, mrpt::math::TPoint3D(xs[i], ys[i], zs[i]));
+		}
+
+		for (size_t i = 0; i < xs.size(); i++)
+		{
+			auto& v = voxels_[key(to_cell(xs[i]), to_cell(ys[i]), to_cell(zs[i]))];
+			v.last_seen = stamp;
+			v.hits++;
+		}
+	}
+
+	/// Removes voxels not seen since `now - ttl`.
+	void decay(double now)
+	{
+		for (auto it = voxels_.begin(); it != voxels_.end();)
+		{
+			if (now - it->second.last_seen > params.ttl)
+				it = voxels_.erase(it);
+			else
+				++it;
+		}
+	}
+
+	/// Calls `f(x,y,z)` for the center of each voxel with enough hits.
+	template <typename FUNCTOR>
+	void get_voxels(FUNCTOR&& f) const
+	{
+		for (const auto& [k, v] : voxels_)
+		{
+			if (v.hits < params.min_hits) continue;
+			int cx, cy, cz;
+			unkey(k, cx, cy, cz);
+			f((cx + 0.5) * params.voxel_size, (cy + 0.5) * params.voxel_size,
+			  (cz + 0.5) * params.voxel_size);
+		}
+	}
+
+   private:
+	std::unordered_map<uint64_t, Voxel> voxels_;
+
+	// 21 bits per axis: +-1e6 cells, i.e. +-100 km with 0.1 m voxels.
+	static constexpr int OFFSET = 1 << 20;
+	static constexpr uint64_t MASK = (1ULL << 21) - 1;
+
+	static uint64_t key(int cx, int cy, int cz)
+	{
+		return (static_cast<uint64_t>(cx + OFFSET) & MASK) |
+			   ((static_cast<uint64_t>(cy + OFFSET) & MASK) << 21) |
+			   ((static_cast<uint64_t>(cz + OFFSET) & MASK) << 42);
+	}
+	static void unkey(uint64_t k, int& cx, int& cy, int& cz)
+	{
+		cx = static_cast<int>(k & MASK) - OFFSET;
+		cy = static_cast<int>((k >> 21) & MASK) - OFFSET;
+		cz = static_cast<int>((k >> 42) & MASK) - OFFSET;
+	}
+
+	int to_cell(double v) const { return static_cast<int>(std::floor(v / params.voxel_size)); }
+
+	/// Removes all voxels traversed by the segment from `a` to `b`, except
+	/// the one containing `b` (3D DDA, Amanatides & Woo, 1987).
+	void clear_ray(const mrpt::math::TPoint3D& a, const mrpt::math::TPoint3D& b)
+	{
+		const double res = params.voxel_size;
+		const double d[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+		const double len = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		if (len < res) return;
+
+		const double p0[3] = {a.x, a.y, a.z};
+		int c[3] = {to_cell(a.x), to_cell(a.y), to_cell(a.z)};
+		const int cEnd[3] = {to_cell(b.x), to_cell(b.y), to_cell(b.z)};
+
+		int step[3];
+		double tMax[3], tDelta[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const double di = d[i] / len;  // unit direction
+			if (di > 0)
+			{
+				step[i] = 1;
+				tMax[i] = ((c[i] + 1) * res - p0[i]) / di;
+				tDelta[i] = res / di;
+			}
+			else if (di < 0)
+			{
+				step[i] = -1;
+				tMax[i] = (c[i] * res - p0[i]) / di;
+				tDelta[i] = -res / di;
+			}
+			else
+			{
+				step[i] = 0;
+				tMax[i] = tDelta[i] = std::numeric_limits<double>::infinity();
+			}
+		}
+
+		const double maxLen = std::min(len, params.max_ray_length);
+		for (double t = 0; t < maxLen;)
+		{
+			if (c[0] == cEnd[0] && c[1] == cEnd[1] && c[2] == cEnd[2]) break;
+
+			voxels_.erase(key(c[0], c[1], c[2]));
+
+			// Advance along the axis whose boundary is closest:
+			const int i = (tMax[0] < tMax[1]) ? (tMax[0] < tMax[2] ? 0 : 2)
+											  : (tMax[1] < tMax[2] ? 1 : 2);
+			t = tMax[i];
+			tMax[i] += tDelta[i];
+			c[i] += step[i];
+		}
+	}
+};
@@ -0,0 +1,71 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/maps/CPointsMap.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/version.h>
+#include <mrpt_pointcloud_pipeline/pose_buffer.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace mrpt_pointcloud_pipeline
+{
+#if MRPT_VERSION >= 0x020b04
+/** Removes, in place, the motion distortion of a point cloud with per-point
+ * timestamps (relative to `stamp`), leaving all points as seen from the
+ * sensor at `stamp`. Points are corrected in `nBins` groups of similar
+ * timestamp, with the robot poses interpolated from `robotPoses`.
+ *
+ * \return false if the cloud has no per-point timestamps.
+ */
+inline bool deskew_point_cloud(
+	mrpt::maps::CPointsMap& pts, const mrpt::poses::CPose3D& sensorPose,
+	const mrpt::poses::CPose3D& robotPose, double stamp, const PoseBuffer& robotPoses,
+	size_t nBins)
+{
+	const auto* ts = pts.getPointsBufferRef_timestamp();
+	if (!ts || ts->size() != pts.size() || ts->empty() || !nBins) return false;
+
+	const auto [itMin, itMax] = std::minmax_element(ts->begin(), ts->end());
+	const double tMin = *itMin, tMax = *itMax;
+	const double binWidth = std::max(1e-9, (tMax - tMin) / nBins);
+
+	// For each time bin: pose of the sensor at that time, relative to the
+	// sensor at the cloud timestamp. Bins without a robot pose available
+	// (e.g. missing odometry) are left uncorrected.
+	const mrpt::poses::CPose3D robotPoseInv = -robotPose;
+	std::vector<mrpt::poses::CPose3D> binPoses(nBins);
+	for (size_t b = 0; b < nBins; b++)
+	{
+		const auto p = robotPoses.interpolate(stamp + tMin + (b + 0.5) * binWidth);
+		if (!p) continue;  // Identity
+		binPoses[b] = -sensorPose + (robotPoseInv + *p) + sensorPose;
+	}
+
+	const auto& xs = pts.getPointsBufferRef_x();
+	const auto& ys = pts.getPointsBufferRef_y();
+	const auto& zs = pts.getPointsBufferRef_z();
+
+	for (size_t i = 0; i < pts.size(); i++)
+	{
+		const size_t b =
+			std::min<size_t>(nBins - 1, static_cast<size_t>(((*ts)[i] - tMin) / binWidth));
+		float x, y, z;
+		binPoses[b].composePoint(xs[i], ys[i], zs[i], x, y, z);
+		pts.setPointFast(i, x, y, z);
+	}
+	pts.mark_as_modified();
+
+	return true;
+}
+#endif
+
+}  // namespace mrpt_pointcloud_pipeline
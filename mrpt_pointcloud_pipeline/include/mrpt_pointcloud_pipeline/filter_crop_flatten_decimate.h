@@ -0,0 +1,87 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mp2p_icp/metricmap.h>
+#include <mp2p_icp_filters/FilterBase.h>
+
+#include <string>
+
+namespace mrpt_pointcloud_pipeline
+{
+/**
+ * Crops a point cloud by height and range, flattens it to 2D and decimates
+ * it, all in one pass over the input points, for 2D navigation obstacles.
+ *
+ * It replaces the chain of FilterBoundingBox (crop), FilterBoundingBox (split
+ * into close and far points) and two FilterDecimateVoxels with `flatten_to`,
+ * without creating the intermediate layers. The result is not identical:
+ * ranges here are radial distances in the XY plane instead of boxes, and
+ * points are binned into 2D columns instead of 3D voxels: cells of
+ * `near_resolution` up to `near_range` from the robot, and of
+ * `far_resolution` beyond it, using a flat open-addressing hash table.
+ *
+ * YAML usage (in the `final` pipeline):
+ * \code
+ *  - class_name: mrpt_pointcloud_pipeline::FilterCropFlattenDecimate
+ *    params:
+ *      input_pointcloud_layer: 'accumulated_points'
+ *      output_pointcloud_layer: 'output'
+ *      min_z: 0.1  # [m]
+ *      max_z: 1.5  # [m]
+ *      max_range: 20.0  # [m]
+ *      near_range: 6.0  # [m]
+ *      near_resolution: 0.10  # [m]
+ *      far_resolution: 0.50  # [m]
+ *      flatten_to: 1.0  # [m]
+ * \endcode
+ */
+class FilterCropFlattenDecimate : public mp2p_icp_filters::FilterBase
+{
+	DEFINE_MRPT_OBJECT(FilterCropFlattenDecimate, mrpt_pointcloud_pipeline)
+   public:
+	FilterCropFlattenDecimate();
+
+	// See docs in base class.
+	void initialize(const mrpt::containers::yaml& c) override;
+
+	// See docs in base class.
+	void filter(mp2p_icp::metric_map_t& inOut) const override;
+
+	struct Parameters
+	{
+		void load_from_yaml(const mrpt::containers::yaml& c);
+
+		std::string input_pointcloud_layer = mp2p_icp::metric_map_t::PT_LAYER_RAW;
+		std::string output_pointcloud_layer = "output";
+
+		/// Points out of this height range are removed [m].
+		double min_z = 0.1, max_z = 1.5;
+
+		/// Points out of this range from the robot (in XY) are removed [m].
+		double min_range = 0, max_range = 20.0;
+
+		/// Points closer than this use `near_resolution`, the rest
+		/// `far_resolution` [m].
+		double near_range = 6.0;
+		double near_resolution = 0.10, far_resolution = 0.50;
+
+		/// Height of all output points [m].
+		double flatten_to = 1.0;
+
+		/// If true, each cell outputs the input point closest to the cell
+		/// average (as DecimateMethod::ClosestToAverage). Otherwise, the
+		/// average itself is output, skipping a second pass over the points.
+		bool closest_to_average = true;
+	};
+
+	Parameters params_;
+};
+
+}  // namespace mrpt_pointcloud_pipeline
@@ -0,0 +1,106 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mp2p_icp/metricmap.h>
+#include <mp2p_icp_filters/FilterBase.h>
+#include <mrpt/core/bits_math.h>
+#include <mrpt/maps/CPointsMap.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mrpt_pointcloud_pipeline
+{
+/**
+ * Splits a point cloud layer into ground and non-ground points, in O(N).
+ *
+ * Points are expected in the robot frame (as output by mp2p_icp generators),
+ * with the ground around z=0 under the robot.
+ *
+ * - If the input layer has a `ring` field (e.g. CPointsMapXYZIRT), points
+ *   are grouped into azimuth columns, ordered by ring elevation. Each column
+ *   is walked outwards from the robot, labeling a point as ground if the
+ *   slope from the last ground point is below `max_slope`.
+ * - Otherwise, a local plane is fit per cell of a 2D grid to the lowest
+ *   points of the cell, and points close to their cell plane are ground.
+ *
+ * Both methods follow the terrain slope (ramps), unlike a fixed z threshold.
+ *
+ * YAML usage (in the `per_observation` pipeline):
+ * \code
+ *  - class_name: mrpt_pointcloud_pipeline::FilterGroundSegmentation
+ *    params:
+ *      input_pointcloud_layer: 'raw'
+ *      obstacles_layer: 'obstacles'
+ *      #ground_layer: 'ground'
+ *      max_slope: 15.0  # [deg]
+ *      ground_threshold: 0.10
+ * \endcode
+ */
+class FilterGroundSegmentation : public mp2p_icp_filters::FilterBase
+{
+	DEFINE_MRPT_OBJECT(FilterGroundSegmentation, mrpt_pointcloud_pipeline)
+   public:
+	FilterGroundSegmentation();
+
+	// See docs in base class.
+	void initialize(const mrpt::containers::yaml& c) override;
+
+	// See docs in base class.
+	void filter(mp2p_icp::metric_map_t& inOut) const override;
+
+	struct Parameters
+	{
+		void load_from_yaml(const mrpt::containers::yaml& c);
+
+		std::string input_pointcloud_layer = mp2p_icp::metric_map_t::PT_LAYER_RAW;
+
+		/// Output layers. At least one must be given.
+		std::string obstacles_layer, ground_layer;
+
+		/// Maximum terrain slope considered as ground [rad].
+		double max_slope = mrpt::DEG2RAD(15.0);
+
+		/// Vertical tolerance to be considered ground [m].
+		double ground_threshold = 0.10;
+
+		/// Ring method: maximum height change between consecutive ground
+		/// points along a column, regardless of their distance [m].
+		double max_ground_step = 0.30;
+
+		/// Use the `ring` field, if present. Otherwise, use the grid method.
+		bool use_rings = true;
+
+		/// Number of azimuth columns for the ring-based method.
+		uint32_t azimuth_sectors = 900;
+
+		/// Cell size [m] for the grid-based method.
+		double grid_cell_size = 1.0;
+
+		/// Grid method: points up to this height over the lowest one in each
+		/// cell are used to fit the cell plane [m].
+		double grid_plane_band = 0.15;
+
+		/// Grid method: cells whose lowest point is higher than this (e.g.
+		/// table tops, with no ground visible below) have no ground [m].
+		double grid_max_ground_z = 1.0;
+	};
+
+	Parameters params_;
+
+   private:
+	/// Returns one flag per point: true for ground.
+	std::vector<bool> segment_rings(
+		const mrpt::maps::CPointsMap& pc, const mrpt::aligned_std_vector<uint16_t>& rings) const;
+	std::vector<bool> segment_grid(const mrpt::maps::CPointsMap& pc) const;
+};
+
+}  // namespace mrpt_pointcloud_pipeline
@@ -0,0 +1,292 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mp2p_icp/metricmap.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt/maps/CPointsMap.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/obs/CObservation.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/version.h>
+#include <mrpt_pointcloud_pipeline/decaying_voxel_map.h>
+#include <mrpt_pointcloud_pipeline/deskew.h>
+#include <mrpt_pointcloud_pipeline/pose_buffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Local map building steps, shared by LocalObstaclesNode and the benchmark
+// tool, so both run exactly the same logic.
+
+namespace mrpt_pointcloud_pipeline
+{
+/// Output of the per-observation stage for one observation.
+struct ProcessedObservation
+{
+	/// Output of the generators and the per-observation pipeline
+	mp2p_icp::metric_map_t::Ptr map;
+
+	/// Whether it was already inserted into the obstacle memory. Only
+	/// accessed while building the local map.
+	bool inserted_in_memory = false;
+
+	/// Version of the pipeline used to build `map`. If outdated, it is built
+	/// again with the current pipeline.
+	uint64_t pipeline_version = 0;
+};
+
+/// One observation of the history used to build local maps.
+struct InfoPerTimeStep
+{
+	std::string sourceTopic;
+	double timestamp = 0;  //!< Sensor timestamp
+	mrpt::obs::CObservation::Ptr observation;
+	mrpt::poses::CPose3D robot_pose;
+
+	/// Filled in only once, the first time this entry is used to build a
+	/// local map. Shared among all copies of this entry.
+	std::shared_ptr<ProcessedObservation> processed = std::make_shared<ProcessedObservation>();
+};
+
+using ObservationList = std::vector<std::shared_ptr<const InfoPerTimeStep>>;
+
+/** Sorts the observations by sensor timestamp, and keeps only those within
+ * `timeWindow` seconds of the latest one. */
+inline ObservationList select_time_window(ObservationList obs, double timeWindow)
+{
+	std::sort(
+		obs.begin(), obs.end(),
+		[](const auto& a, const auto& b) { return a->timestamp < b->timestamp; });
+
+	if (!obs.empty())
+	{
+		const double last_time = obs.back()->timestamp;
+		const auto itFirstValid = std::lower_bound(
+			obs.begin(), obs.end(), last_time - timeWindow,
+			[](const auto& e, double t) { return e->timestamp < t; });
+		obs.erase(obs.begin(), itFirstValid);
+	}
+	return obs;
+}
+
+/// Keeps only the latest observation of each topic, in timestamp order.
+inline ObservationList latest_per_topic(const ObservationList& obs)
+{
+	// Traverse newest-first, to keep the latest one of each topic:
+	std::set<std::string> foundTopics;
+	ObservationList latest;
+	for (auto it = obs.rbegin(); it != obs.rend(); ++it)
+	{
+		if (!foundTopics.insert((*it)->sourceTopic).second) continue;  // duplicated
+		latest.push_back(*it);
+	}
+	return {latest.rbegin(), latest.rend()};
+}
+
+/** Merges the processed maps of all observations into `mm`, relative to the
+ * robot pose `curRobotPose`, in the given order. All observations must have
+ * been processed already. */
+inline void merge_observations(
+	const ObservationList& obs, const mrpt::poses::CPose3D& curRobotPose,
+	mp2p_icp::metric_map_t& mm)
+{
+	for (const auto& ipt : obs)
+	{
+		ASSERT_(ipt->processed && ipt->processed->map);
+
+		// Relative pose of the robot when the observation was taken, wrt
+		// its pose for the latest one:
+		mrpt::poses::CPose3D relPose(mrpt::poses::UNINITIALIZED_POSE);
+		relPose.inverseComposeFrom(ipt->robot_pose, curRobotPose);
+
+		mm.merge_with(*ipt->processed->map, relPose.asTPose());
+	}
+}
+
+/** Inserts the observations not inserted yet into `memory` (the layer
+ * `sourceLayer` of their processed maps, as returned by `getMap(ipt)`),
+ * applies decay up to `decayTime`, and returns the memory contents relative
+ * to `robotPose`.
+ *
+ * \param[out] nInserted If not null, the number of points inserted.
+ */
+template <typename GET_MAP>
+mrpt::maps::CSimplePointsMap::Ptr update_memory(
+	DecayingVoxelMap& memory, const ObservationList& obs, const std::string& sourceLayer,
+	double decayTime, const mrpt::poses::CPose3D& robotPose, GET_MAP&& getMap,
+	size_t* nInserted = nullptr)
+{
+	if (nInserted) *nInserted = 0;
+
+	for (const auto& ipt : obs)
+	{
+		auto& p = *ipt->processed;
+		if (p.inserted_in_memory) continue;
+		p.inserted_in_memory = true;
+
+		const mp2p_icp::metric_map_t& obsMap = getMap(*ipt);
+		const auto pts = obsMap.point_layer(sourceLayer);
+		if (!pts) continue;
+
+		// Points are relative to the robot at the observation time: move
+		// them to the reference frame:
+		const auto& lxs = pts->getPointsBufferRef_x();
+		const auto& lys = pts->getPointsBufferRef_y();
+		const auto& lzs = pts->getPointsBufferRef_z();
+
+		std::vector<double> xs(lxs.size()), ys(lxs.size()), zs(lxs.size());
+		for (size_t i = 0; i < lxs.size(); i++)
+			ipt->robot_pose.composePoint(lxs[i], lys[i], lzs[i], xs[i], ys[i], zs[i]);
+
+		mrpt::poses::CPose3D sensorPose;
+		ipt->observation->getSensorPose(sensorPose);
+
+		memory.insert((ipt->robot_pose + sensorPose).translation(), xs, ys, zs, ipt->timestamp);
+		if (nInserted) *nInserted += lxs.size();
+	}
+
+	memory.decay(decayTime);
+
+	// Relative to the current robot pose, as all other local map layers:
+	const auto robotPoseInv = -robotPose;
+	auto out = mrpt::maps::CSimplePointsMap::Create();
+	out->reserve(memory.size());
+	memory.get_voxels(
+		[&](double x, double y, double z)
+		{
+			double lx, ly, lz;
+			robotPoseInv.composePoint(x, y, z, lx, ly, lz);
+			out->insertPoint(lx, ly, lz);
+		});
+	return out;
+}
+
+/// How input point clouds are stored in observations.
+struct PointCloudOptions
+{
+	/// Keep the per-point `ring` field, for ring-based filters (e.g.
+	/// FilterGroundSegmentation).
+	bool keep_ring_field = false;
+
+	/// Deskew clouds with per-point timestamps, using the robot poses
+	/// interpolated at each point time.
+	bool deskew_enable = false;
+
+	/// Points are deskewed in groups of similar timestamp, this many per scan.
+	size_t deskew_time_bins = 64;
+};
+
+/** Whether a cloud with these per-point fields must keep them, instead of
+ * being stored as plain (x,y,z) points. */
+inline bool needs_point_fields(const PointCloudOptions& opts, bool hasRing, bool hasTime)
+{
+	return (opts.keep_ring_field && hasRing) || (opts.deskew_enable && hasTime);
+}
+
+/** Prepares a point cloud to be stored in an observation: it is deskewed in
+ * place, if enabled and it has per-point timestamps, and returned as is, or
+ * as a plain (x,y,z) copy if its per-point fields are not needed. */
+inline mrpt::maps::CPointsMap::Ptr prepare_point_cloud(
+	const mrpt::maps::CPointsMap::Ptr& pts, const PointCloudOptions& opts,
+	[[maybe_unused]] const mrpt::poses::CPose3D& sensorPose,
+	[[maybe_unused]] const mrpt::poses::CPose3D& robotPose, [[maybe_unused]] double stamp,
+	[[maybe_unused]] const PoseBuffer& robotPoses)
+{
+	ASSERT_(pts);
+
+	bool keepFields = false;
+#if MRPT_VERSION >= 0x020b04
+	const auto* rings = pts->getPointsBufferRef_ring();
+	const auto* times = pts->getPointsBufferRef_timestamp();
+	const bool hasTime = times && !times->empty();
+	keepFields = needs_point_fields(opts, rings && !rings->empty(), hasTime);
+
+	if (opts.deskew_enable && hasTime)
+		deskew_point_cloud(*pts, sensorPose, robotPose, stamp, robotPoses, opts.deskew_time_bins);
+#endif
+
+	if (keepFields || std::dynamic_pointer_cast<mrpt::maps::CSimplePointsMap>(pts)) return pts;
+
+	auto xyz = mrpt::maps::CSimplePointsMap::Create();
+	xyz->insertAnotherMap(pts.get(), mrpt::poses::CPose3D::Identity());
+	return xyz;
+}
+
+/** Decides when to build a new local map as soon as new observations
+ * arrive, besides the periodic publish timer. Thread-safe.
+ */
+class PublishTriggers
+{
+   public:
+	enum class Trigger
+	{
+		None,
+		EveryNScans,
+		AllSensorsFresh
+	};
+
+	/// If >0, trigger every time this number of new observations have
+	/// arrived since the last local map.
+	int publish_every_n_scans = 0;
+
+	/// Trigger as soon as all `source_topics` have new observations since the
+	/// last local map.
+	bool publish_on_all_sensors_fresh = false;
+
+	std::vector<std::string> source_topics;
+
+	/// To be called after storing each new observation, with the total number
+	/// of observations stored so far (`head`).
+	Trigger on_new_observation(const std::string& topic, double stamp, uint64_t head)
+	{
+		std::lock_guard<std::mutex> lck(mtx_);
+		last_obs_stamp_[topic] = stamp;
+
+		if (publish_every_n_scans > 0 &&
+			head - last_head_ >= static_cast<uint64_t>(publish_every_n_scans))
+			return Trigger::EveryNScans;
+
+		if (!publish_on_all_sensors_fresh) return Trigger::None;
+
+		for (const auto& t : source_topics)
+		{
+			const auto it = last_obs_stamp_.find(t);
+			if (it == last_obs_stamp_.end() || it->second <= last_stamp_) return Trigger::None;
+		}
+		return Trigger::AllSensorsFresh;
+	}
+
+	/// To be called for each local map, built from the first `head`
+	/// observations, the latest one with timestamp `stamp`.
+	void on_local_map(uint64_t head, double stamp)
+	{
+		std::lock_guard<std::mutex> lck(mtx_);
+		last_head_ = head;
+		last_stamp_ = stamp;
+	}
+
+	/// `head` of the last local map. If unchanged, nothing new arrived.
+	uint64_t last_head() const { return last_head_; }
+
+   private:
+	std::mutex mtx_;
+	std::map<std::string, double> last_obs_stamp_;	//!< Latest obs. per topic
+	double last_stamp_ = 0;	 //!< Latest obs. in the last local map
+	std::atomic<uint64_t> last_head_{0};
+};
+
+}  // namespace mrpt_pointcloud_pipeline
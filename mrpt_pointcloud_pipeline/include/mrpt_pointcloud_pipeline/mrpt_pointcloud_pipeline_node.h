@@ -8,13 +8,21 @@
 
 /* mrpt deps*/
 #include <mp2p_icp/icp_pipeline_from_yaml.h>
+#include <mp2p_icp/metricmap.h>
 #include <mp2p_icp_filters/FilterDecimateVoxels.h>
 #include <mp2p_icp_filters/Generator.h>
 #include <mrpt/config/CConfigFile.h>
 #include <mrpt/containers/yaml.h>
+#include <mrpt/core/WorkerThreadsPool.h>
+#include <mrpt/core/lock_helper.h>
 #include <mrpt/gui/CDisplayWindow3D.h>
 #include <mrpt/maps/COccupancyGridMap2D.h>
 #include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/version.h>
+#if MRPT_VERSION >= 0x020b04
+#include <mrpt/maps/CPointsMapXYZI.h>
+#include <mrpt/maps/CPointsMapXYZIRT.h>
+#endif
 #include <mrpt/obs/CObservation2DRangeScan.h>
 #include <mrpt/obs/CObservationPointCloud.h>
 #include <mrpt/obs/CSensoryFrame.h>
@@ -28,14 +36,26 @@
 #include <mrpt/system/CTimeLogger.h>
 #include <mrpt/system/filesystem.h>
 #include <mrpt/system/string_utils.h>
+#include <mrpt_pointcloud_pipeline/decaying_voxel_map.h>
+#include <mrpt_pointcloud_pipeline/local_map_builder.h>
+#include <mrpt_pointcloud_pipeline/observation_ring.h>
+#include <mrpt_pointcloud_pipeline/obstacle_grid_2d.h>
+#include <mrpt_pointcloud_pipeline/pose_buffer.h>
 
 /* ros2 deps */
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_listener.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <future>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <nav_msgs/msg/occupancy_grid.hpp>
 #include <nav_msgs/msg/odometry.hpp>
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/laser_scan.hpp>
@@ -71,6 +91,26 @@ class LocalObstaclesNode : public rclcpp::Node
 	void on_new_sensor_pointcloud(
 		const sensor_msgs::msg::PointCloud2::SharedPtr& pts, const std::string& topicName);
 
+	/* Callback: On new odometry: append to the robot pose buffer */
+	void on_odometry(const nav_msgs::msg::Odometry::SharedPtr& odo);
+
+	/* Updates the obstacle grid from the given local map (relative to
+	 * the robot pose `robotPose`), and publishes it. */
+	void publish_obstacle_grid(
+		const mp2p_icp::metric_map_t& mm, const mrpt::poses::CPose3D& robotPose, double stamp);
+
+	/* Timer: appends the latest reference->robot /tf to the pose buffer.
+	 * Only used if no odometry topic is given. */
+	void sample_robot_pose_from_tf();
+
+	/* Returns the (cached) pose of a sensor frame wrt the robot frame, or
+	 * nullopt if it is not available in /tf yet. */
+	std::optional<mrpt::poses::CPose3D> get_sensor_pose(const std::string& sensorFrameId);
+
+	/* Returns the robot pose in the reference frame at the given sensor
+	 * timestamp, interpolated from the pose buffer. */
+	std::optional<mrpt::poses::CPose3D> get_robot_pose(double timestamp);
+
 	/**
 	 * @brief Subscribe to a variable number of topics.
 	 * @param lstTopics String with list of topics separated with ","
@@ -81,7 +121,7 @@ class LocalObstaclesNode : public rclcpp::Node
 	size_t subscribe_to_multiple_topics(
 		const std::string& lstTopics,
 		std::vector<typename rclcpp::Subscription<MessageT>::SharedPtr>& subscriptions,
-		CallbackMethodType callback)
+		CallbackMethodType callback, const rclcpp::SubscriptionOptions& options)
 	{
 		size_t num_subscriptions = 0;
 		std::vector<std::string> lstSources;
@@ -97,8 +137,10 @@ class LocalObstaclesNode : public rclcpp::Node
 			const auto sub = this->create_subscription<MessageT>(
 				source, 1,
 				[source, callback, this](const typename MessageT::SharedPtr msg)
-				{ callback(msg, source); });
+				{ callback(msg, source); },
+				options);
 			subscriptions.push_back(sub);  // 1 is the queue size
+			m_publish_triggers.source_topics.push_back(source);
 			num_subscriptions++;
 		}
 
@@ -115,26 +157,70 @@ class LocalObstaclesNode : public rclcpp::Node
 	std::string m_topics_source_2dscan = "scan, laser1";  //!< Default: "scan, laser1"
 	std::string m_topics_source_pointclouds = "";
 
+	/// If not empty, robot poses are read from this nav_msgs/Odometry topic
+	/// instead of sampling /tf.
+	std::string m_topic_odometry = "";
+
+	//!< In secs (default: 0.02). Period to sample /tf if no odometry is used.
+	double m_tf_sample_period = 0.02;
+
+	/// Deskewing and per-point fields of input point clouds. Otherwise, only
+	/// XYZ points are kept.
+	mrpt_pointcloud_pipeline::PointCloudOptions m_point_cloud_options;
+
 	//!< In secs (default: 0.2). Can't be smaller than m_publish_period
 	double m_time_window = 0.20;
 
 	//!< In secs (default: 0.05). Can't be larger than m_time_window
 	double m_publish_period = 0.05;
 
+	/// If true, the per-observation pipeline runs as soon as each observation
+	/// arrives, instead of in the next publish tick.
+	bool m_process_on_arrival = false;
+
+	/// Whether to also publish the local map as soon as new observations
+	/// arrive: every N of them, and/or as soon as all sensor topics have new
+	/// data since the last published map (with a single sensor, this means
+	/// publishing on each new observation). Also keeps the state of the last
+	/// published map.
+	mrpt_pointcloud_pipeline::PublishTriggers m_publish_triggers;
+
 	rclcpp::TimerBase::SharedPtr m_timer_publish;
+	rclcpp::TimerBase::SharedPtr m_timer_tf_sample;
+
+	/// Sensor callbacks (reentrant, so sensors are processed in parallel),
+	/// and publish timer.
+	rclcpp::CallbackGroup::SharedPtr m_cb_group_sensors, m_cb_group_publish;
+
+	/// Held while building and publishing the local map, which may be
+	/// triggered from the timer or from sensor callbacks.
+	std::mutex m_publish_mtx;
+
+	/// Robot poses in the reference frame (typ: /odom -> /base_link), used to
+	/// find the robot pose at the exact timestamp of each observation.
+	PoseBuffer m_robot_poses;
+
+	/// Sensor poses wrt the robot, assumed static, indexed by frame_id.
+	std::map<std::string, mrpt::poses::CPose3D> m_sensor_poses;
+	std::mutex m_sensor_poses_mtx;
 
 	// Sensor data:
-	struct InfoPerTimeStep
-	{
-		std::string sourceTopic;
-		CObservation::Ptr observation;
-		mrpt::poses::CPose3D robot_pose;
-	};
-	using obs_list_t = std::multimap<double, InfoPerTimeStep>;
+	using InfoPerTimeStep = mrpt_pointcloud_pipeline::InfoPerTimeStep;
+
+	/// The history of past observations, in arrival order. Entries older
+	/// than the time window are ignored when building the local map, and
+	/// eventually overwritten by new ones.
+	ObservationRing<InfoPerTimeStep> m_hist_obs;
+
+	/* Runs the generators and the per-observation pipeline for one entry,
+	 * unless it was already done in a former call. Safe to call from worker
+	 * threads, as long as each call is for a different entry. */
+	const mp2p_icp::metric_map_t& get_processed_observation(const InfoPerTimeStep& ipt);
 
-	/// The history of past observations duringthe interest time window.
-	obs_list_t m_hist_obs;
-	std::mutex m_hist_obs_mtx;	//!< mutex
+	/* Inserts a new observation into the history. If enabled, it runs the
+	 * per-observation pipeline first (stage 1), and triggers a publish
+	 * (stage 2) if m_publish_triggers say so. */
+	void on_new_observation(InfoPerTimeStep&& ipt);
 
 	mrpt::gui::CDisplayWindow3D::Ptr m_gui_win;
 	bool m_visible_raw = true, m_visible_output = true;
@@ -142,24 +228,108 @@ class LocalObstaclesNode : public rclcpp::Node
 	/// Used for example to run voxel grid decimation, etc.
 	/// Refer to mp2p_icp docs
 	std::string m_pipeline_yaml_file;
-	mp2p_icp_filters::FilterPipeline m_per_obs_pipeline, m_final_pipeline;
-	mp2p_icp_filters::GeneratorSet m_generator;
+	mp2p_icp_filters::FilterPipeline m_final_pipeline;
+
+	/// Generators and per-observation pipeline. There is one independent
+	/// instance per worker thread, since filters may keep internal state.
+	struct PerObsPipeline
+	{
+		mp2p_icp_filters::GeneratorSet generator;
+		mp2p_icp_filters::FilterPipeline pipeline;
+	};
+	std::vector<PerObsPipeline> m_per_obs_pipelines;
+	std::vector<size_t> m_free_per_obs_pipelines;  //!< Indices not in use
+	std::mutex m_free_per_obs_pipelines_mtx;
+	std::condition_variable m_free_per_obs_pipelines_cv;
+
+	/// Incremented each time the pipelines are replaced. Only modified
+	/// while holding m_free_per_obs_pipelines_mtx.
+	std::atomic<uint64_t> m_pipeline_version{0};
+
+	/// All pipelines defined in one pipeline YAML file.
+	struct PipelineSet
+	{
+		std::vector<PerObsPipeline> per_obs;  //!< One per worker
+		mp2p_icp_filters::FilterPipeline final;
+	};
+
+	/* Parses a pipeline YAML file, with `numInstances` independent copies of
+	 * the generators and per-observation pipeline. Throws on errors. */
+	PipelineSet load_pipelines(const std::string& yamlFile, size_t numInstances) const;
+
+	/* Runs a loaded set of pipelines on a copy of the latest observation, if
+	 * any, with an empty obstacle memory layer if enabled, and checks that
+	 * all the layers used by this node are generated. Throws on errors. */
+	void validate_pipelines(PipelineSet& ps) const;
+
+	/* Hot reload: parses and validates m_pipeline_yaml_file in a background
+	 * thread. On success, it replaces the current pipelines in the next
+	 * on_do_publish(). */
+	void request_pipeline_reload();
+	void pipeline_reload_task();
+
+	/* Called from on_do_publish(): replaces the current pipelines by the
+	 * reloaded ones, if any, once no worker is using them. Returns true if
+	 * they were replaced. */
+	bool apply_pending_pipelines();
+
+	/* Timer: triggers a reload if the pipeline file was modified. */
+	void check_pipeline_file_modified();
+
+	/// Period to check the pipeline file for changes [s]. 0: disabled.
+	double m_pipeline_watch_period = 1.0;
+	size_t m_num_pipeline_instances = 1;
+
+	/// Held while accessing m_pipeline_yaml_file, m_pending_pipelines and
+	/// the rest of the reload state, after construction.
+	std::mutex m_pipeline_reload_mtx;
+	std::optional<PipelineSet> m_pending_pipelines;
+	bool m_pipeline_reload_requested = false, m_pipeline_reload_running = false;
+	time_t m_pipeline_file_mtime = 0;
+	rclcpp::TimerBase::SharedPtr m_timer_pipeline_watch;
+	rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr m_on_set_params_handle;
+
+	/// Number of threads for the per-observation stage (0: one per core).
+	int m_num_worker_threads = 0;
+	/// Empty if only one thread is used.
+	std::unique_ptr<mrpt::WorkerThreadsPool> m_workers;
 
 	struct LayerTopicNames
 	{
 		std::string layer;
 		std::string topic;
 		rclcpp::Publisher<sensor_msgs::msg::PointCloud2>::SharedPtr pub;
+		/// Reused across publishes, to keep its memory allocated.
+		sensor_msgs::msg::PointCloud2 msg_buffer;
 	};
 	std::vector<LayerTopicNames> layer2topic_;
 
+	/// Optional robot-centered obstacle grid, in the reference frame, built
+	/// from one layer of the final local map.
+	ObstacleGrid2D m_obstacle_grid;
+	std::string m_grid_layer;  //!< Default: the first output layer
+	rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr m_pub_grid;
+
+	/// Optional obstacle memory in the reference frame, to keep obstacles
+	/// longer than the time window (e.g. out of the sensors field of view).
+	DecayingVoxelMap m_memory;
+	std::string m_memory_source_layer;	//!< Per-observation layer. Empty: disabled
+	std::string m_memory_output_layer = "memory";
+	/// Node clock time of the last local map with new observations [s]
+	double m_memory_last_new_obs_clock = 0;
+
 	/**
 	 * @name ROS2 pubs/subs
 	 * @{
 	 */
 	std::vector<rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr> m_subs_2dlaser;
 	std::vector<rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr> m_subs_pointclouds;
+	rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr m_sub_odometry;
 
 	std::shared_ptr<tf2_ros::Buffer> m_tf_buffer;
 	std::shared_ptr<tf2_ros::TransformListener> m_tf_listener;
+
+	/// Background pipeline reload. Declared last, so it is waited for before
+	/// any other member is destroyed.
+	std::future<void> m_pipeline_reload_task;
 };
@@ -0,0 +1,82 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/core/exceptions.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Fixed-capacity ring of immutable entries, with insertion from any number of
+ * writers and snapshots from readers.
+ *
+ * A single mutex guards the ring, but it is only held to move or copy entry
+ * pointers: entries are allocated before taking it, and copied out of a
+ * snapshot only as shared pointers, so neither writers nor readers do any
+ * actual work while holding it.
+ */
+template <typename T>
+class ObservationRing
+{
+   public:
+	using value_ptr = std::shared_ptr<const T>;
+
+	explicit ObservationRing(size_t capacity = 64) { reset(capacity); }
+
+	/// Not thread-safe: call before any concurrent use.
+	void reset(size_t capacity)
+	{
+		ASSERT_GT_(capacity, 0U);
+		slots_ = std::vector<value_ptr>(capacity);
+		head_ = 0;
+	}
+
+	size_t capacity() const { return slots_.size(); }
+
+	/// Total number of insertions so far.
+	uint64_t head() const { return head_.load(std::memory_order_acquire); }
+
+	void push(T&& value)
+	{
+		value_ptr e = std::make_shared<const T>(std::move(value));
+
+		std::lock_guard<std::mutex> lck(mtx_);
+		const uint64_t h = head_.load(std::memory_order_relaxed);
+		slots_[h % slots_.size()].swap(e);
+		head_.store(h + 1, std::memory_order_release);
+		// The overwritten entry, if any, is released out of the lock, in e.
+	}
+
+	/** Returns all valid entries, from oldest to newest insertion order.
+	 *  \param[out] outHead If not null, the head() the snapshot is based on.
+	 */
+	std::vector<value_ptr> snapshot(uint64_t* outHead = nullptr) const
+	{
+		std::vector<value_ptr> out;
+		out.reserve(slots_.size());
+
+		std::lock_guard<std::mutex> lck(mtx_);
+		const uint64_t h = head_.load(std::memory_order_relaxed);
+		const uint64_t cap = slots_.size();
+		const uint64_t first = h > cap ? h - cap : 0;
+		if (outHead) *outHead = h;
+
+		for (uint64_t seq = first; seq < h; seq++) out.push_back(slots_[seq % cap]);
+		return out;
+	}
+
+   private:
+	mutable std::mutex mtx_;
+	std::vector<value_ptr> slots_;
+	std::atomic<uint64_t> head_{0};	 //!< Total insertions. Written with mtx_ held
+};
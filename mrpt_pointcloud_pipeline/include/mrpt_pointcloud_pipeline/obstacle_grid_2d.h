@@ -0,0 +1,125 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/core/exceptions.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Fixed-size, axis-aligned 2D obstacle grid that follows the robot.
+ *
+ * The local map already holds all current obstacles, so the grid keeps no
+ * cells between updates: each one just moves the grid origin and rasterizes
+ * the obstacle points straight into the output buffer.
+ *
+ * Cell values follow nav_msgs/OccupancyGrid: OCCUPIED for cells with
+ * obstacle points, FREE for cells crossed by a ray from the sensor to an
+ * obstacle point, and UNKNOWN for all other cells, since the obstacle points
+ * alone tell nothing about them.
+ */
+class ObstacleGrid2D
+{
+   public:
+	static constexpr int8_t UNKNOWN = -1;
+	static constexpr int8_t FREE = 0;
+	static constexpr int8_t OCCUPIED = 100;
+
+	/// `size` is the side length of the square grid [m].
+	void resize(double resolution, double size)
+	{
+		ASSERT_GT_(resolution, 0);
+		ASSERT_GT_(size, resolution);
+
+		resolution_ = resolution;
+		n_ = static_cast<int>(std::ceil(size / resolution));
+	}
+
+	double resolution() const { return resolution_; }
+	/// Number of cells per side
+	int size() const { return n_; }
+
+	/// Global cell coordinates of the grid (0,0) corner.
+	int origin_cx() const { return ox_; }
+	int origin_cy() const { return oy_; }
+
+	/// Moves the grid so it becomes centered at (x,y).
+	void recenter(double x, double y)
+	{
+		ASSERT_(n_ > 0);
+		ox_ = to_cell(x) - n_ / 2;
+		oy_ = to_cell(y) - n_ / 2;
+	}
+
+	/// Rasterizes the given obstacle points, as seen from a sensor at
+	/// (sensorX,sensorY), all in the grid frame, in row-major order starting
+	/// at the grid corner, as expected by nav_msgs/OccupancyGrid. Points
+	/// outside of the grid only clear the cells of their rays within it.
+	template <typename VEC>
+	void rasterize(
+		const VEC& xs, const VEC& ys, double sensorX, double sensorY,
+		std::vector<int8_t>& out) const
+	{
+		ASSERT_EQUAL_(xs.size(), ys.size());
+
+		out.assign(static_cast<size_t>(n_) * n_, UNKNOWN);
+
+		const int sx = to_cell(sensorX) - ox_, sy = to_cell(sensorY) - oy_;
+		if (inside(sx, sy))
+		{
+			for (size_t i = 0; i < xs.size(); i++)
+				clear_ray(sx, sy, to_cell(xs[i]) - ox_, to_cell(ys[i]) - oy_, out);
+		}
+
+		// Obstacles last, so no ray clears them:
+		for (size_t i = 0; i < xs.size(); i++)
+		{
+			const int cx = to_cell(xs[i]) - ox_, cy = to_cell(ys[i]) - oy_;
+			if (!inside(cx, cy)) continue;
+			out[static_cast<size_t>(cy) * n_ + cx] = OCCUPIED;
+		}
+	}
+
+   private:
+	double resolution_ = 0.05;
+	int n_ = 0;
+	int ox_ = 0, oy_ = 0;
+
+	int to_cell(double v) const { return static_cast<int>(std::floor(v / resolution_)); }
+
+	bool inside(int cx, int cy) const { return cx >= 0 && cy >= 0 && cx < n_ && cy < n_; }
+
+	/// Marks as FREE the cells from (x0,y0), which must be inside the grid,
+	/// towards (x1,y1), this one excluded (Bresenham), until leaving the grid.
+	void clear_ray(int x0, int y0, int x1, int y1, std::vector<int8_t>& out) const
+	{
+		const int dx = std::abs(x1 - x0), dy = -std::abs(y1 - y0);
+		const int stepX = x0 < x1 ? 1 : -1, stepY = y0 < y1 ? 1 : -1;
+		int err = dx + dy;
+
+		while ((x0 != x1 || y0 != y1) && inside(x0, y0))
+		{
+			out[static_cast<size_t>(y0) * n_ + x0] = FREE;
+
+			const int e2 = 2 * err;
+			if (e2 >= dy)
+			{
+				err += dy;
+				x0 += stepX;
+			}
+			if (e2 <= dx)
+			{
+				err += dx;
+				y0 += stepY;
+			}
+		}
+	}
+};
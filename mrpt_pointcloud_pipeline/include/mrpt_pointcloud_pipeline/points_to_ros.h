@@ -0,0 +1,63 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/ros2bridge/point_cloud2.h>
+#include <mrpt/version.h>
+#if MRPT_VERSION >= 0x020b04
+#include <mrpt/maps/CPointsMapXYZI.h>
+#include <mrpt/maps/CPointsMapXYZIRT.h>
+#endif
+
+#include <sensor_msgs/msg/point_cloud2.hpp>
+#include <std_msgs/msg/header.hpp>
+
+namespace mrpt_pointcloud_pipeline
+{
+/** Converts any points map into a PointCloud2, keeping the per-point fields
+ * of the known point map classes.
+ *
+ * `msg` may be a message reused from a former call: its former fields and
+ * data are discarded, but the data buffer capacity is kept.
+ */
+inline void points_to_ros(
+	const mrpt::maps::CPointsMap& pts, const std_msgs::msg::Header& header,
+	sensor_msgs::msg::PointCloud2& msg)
+{
+	// toROS() appends the field descriptions, so they would be duplicated
+	// on each reuse of the same message:
+	msg.fields.clear();
+	msg.data.clear();
+
+	if (const auto* p = dynamic_cast<const mrpt::maps::CSimplePointsMap*>(&pts); p)
+	{
+		mrpt::ros2bridge::toROS(*p, header, msg);
+		return;
+	}
+#if MRPT_VERSION >= 0x020b04
+	if (const auto* p = dynamic_cast<const mrpt::maps::CPointsMapXYZIRT*>(&pts); p)
+	{
+		mrpt::ros2bridge::toROS(*p, header, msg);
+		return;
+	}
+	if (const auto* p = dynamic_cast<const mrpt::maps::CPointsMapXYZI*>(&pts); p)
+	{
+		mrpt::ros2bridge::toROS(*p, header, msg);
+		return;
+	}
+#endif
+	// Other classes: publish just (x,y,z):
+	mrpt::maps::CSimplePointsMap xyz;
+	xyz.insertAnotherMap(&pts, mrpt::poses::CPose3D::Identity());
+	mrpt::ros2bridge::toROS(xyz, header, msg);
+}
+
+}  // namespace mrpt_pointcloud_pipeline
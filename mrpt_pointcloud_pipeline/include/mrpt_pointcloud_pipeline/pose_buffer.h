@@ -0,0 +1,90 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/poses/Lie/SE.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * Thread-safe, time-indexed buffer of robot poses (typ. odom -> base_link),
+ * with SE(3) interpolation at arbitrary timestamps in O(log N).
+ */
+class PoseBuffer
+{
+   public:
+	/// Entries older than this [s] wrt the newest one are discarded.
+	double max_length = 2.0;
+
+	/// Queries newer than the last entry by up to this time [s] return the
+	/// last pose, instead of failing.
+	double max_extrapolation = 0.1;
+
+	/// Add a new pose. Out-of-order entries are inserted at their place.
+	void add(double t, const mrpt::poses::CPose3D& pose)
+	{
+		std::lock_guard<std::mutex> lck(mtx_);
+
+		if (buf_.empty() || t > buf_.back().first)
+			buf_.emplace_back(t, pose);
+		else
+			buf_.emplace(lower_bound(t), t, pose);
+
+		while (!buf_.empty() && buf_.front().first < buf_.back().first - max_length)
+			buf_.pop_front();
+	}
+
+	/// Returns the interpolated pose at `t`, or nullopt if `t` is out of the
+	/// buffer time range.
+	std::optional<mrpt::poses::CPose3D> interpolate(double t) const
+	{
+		using mrpt::poses::Lie::SE;
+
+		std::lock_guard<std::mutex> lck(mtx_);
+
+		if (buf_.empty() || t < buf_.front().first) return {};
+		if (t >= buf_.back().first)
+		{
+			if (t - buf_.back().first > max_extrapolation) return {};
+			return buf_.back().second;
+		}
+
+		const auto it1 = lower_bound(t);  // first entry with time >= t
+		if (it1->first == t) return it1->second;
+		const auto it0 = std::prev(it1);
+
+		// p = p0 (+) exp(alpha * log(p0^-1 (+) p1))
+		const double alpha = (t - it0->first) / (it1->first - it0->first);
+		const auto& p0 = it0->second;
+		auto incr = SE<3>::log(it1->second - p0);
+		incr *= alpha;
+		return p0 + SE<3>::exp(incr);
+	}
+
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lck(mtx_);
+		return buf_.empty();
+	}
+
+   private:
+	using entry_t = std::pair<double, mrpt::poses::CPose3D>;
+	std::deque<entry_t> buf_;
+	mutable std::mutex mtx_;
+
+	std::deque<entry_t>::const_iterator lower_bound(double t) const
+	{
+		return std::lower_bound(
+			buf_.begin(), buf_.end(), t, [](const entry_t& e, double v) { return e.first < v; });
+	}
+};
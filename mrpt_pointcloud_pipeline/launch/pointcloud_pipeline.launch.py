@@ -34,6 +34,11 @@ def generate_launch_description():
         'points_topic_name',
         default_value=''  # '/ouster/points', etc.
     )
+    odometry_topic_name_arg = DeclareLaunchArgument(
+        'odometry_topic_name',
+        default_value='',  # '/odom', etc.
+        description='If empty, robot poses are sampled from /tf instead.'
+    )
     show_gui_arg = DeclareLaunchArgument(
         'show_gui',
         default_value='True'
@@ -46,6 +51,21 @@ def generate_launch_description():
         'one_observation_per_topic',
         default_value='false'
     )
+    process_on_arrival_arg = DeclareLaunchArgument(
+        'process_on_arrival',
+        default_value='false',
+        description='If true, the per-observation pipeline runs as soon as each observation arrives, instead of in the next publish tick.'
+    )
+    publish_on_all_sensors_fresh_arg = DeclareLaunchArgument(
+        'publish_on_all_sensors_fresh',
+        default_value='false',
+        description='If true, the local map is also published as soon as all sensor topics have new data since the last published map. With a single sensor, this publishes on every scan.'
+    )
+    publish_every_n_scans_arg = DeclareLaunchArgument(
+        'publish_every_n_scans',
+        default_value='0',
+        description='If >0, the local map is also published every time this number of new observations have arrived.'
+    )
     pipeline_yaml_file_arg = DeclareLaunchArgument(
         'pipeline_yaml_file',
         default_value=os.path.join(
@@ -61,6 +81,11 @@ def generate_launch_description():
         default_value='/local_map_pointcloud',
         description='The topic name to publish the output layer map(s). Comma-separated list of more than one, then the number must match that of filter_output_layer_name.'
     )
+    grid_output_topic_arg = DeclareLaunchArgument(
+        'grid_output_topic_name',
+        default_value='',
+        description='If not empty, a robot-centered nav_msgs/OccupancyGrid with the obstacles in the (first) output layer is published to this topic.'
+    )
     frameid_reference_arg = DeclareLaunchArgument(
         'frameid_reference',
         default_value='odom'
@@ -93,6 +118,7 @@ def generate_launch_description():
             {'source_topics_2d_scans': LaunchConfiguration('scan_topic_name')},
             {'source_topics_pointclouds': LaunchConfiguration(
                 'points_topic_name')},
+            {'topic_odometry': LaunchConfiguration('odometry_topic_name')},
             {'show_gui': LaunchConfiguration('show_gui')},
             {'pipeline_yaml_file': LaunchConfiguration('pipeline_yaml_file')},
             {'filter_output_layer_name': LaunchConfiguration(
@@ -100,11 +126,19 @@ def generate_launch_description():
             {'time_window': LaunchConfiguration('time_window')},
             {'topic_local_map_pointcloud': LaunchConfiguration(
                 'filter_output_topic_name')},
+            {'topic_local_map_grid': LaunchConfiguration(
+                'grid_output_topic_name')},
             {'frameid_reference': LaunchConfiguration(
                 'frameid_reference')},
             {'frameid_robot': LaunchConfiguration('frameid_robot')},
             {'one_observation_per_topic': LaunchConfiguration(
                 'one_observation_per_topic')},
+            {'process_on_arrival': LaunchConfiguration(
+                'process_on_arrival')},
+            {'publish_on_all_sensors_fresh': LaunchConfiguration(
+                'publish_on_all_sensors_fresh')},
+            {'publish_every_n_scans': LaunchConfiguration(
+                'publish_every_n_scans')},
         ],
         arguments=['--ros-args', '--log-level',
                    LaunchConfiguration('log_level')],
@@ -122,14 +156,19 @@ def generate_launch_description():
                 parameters=[
                     {'source_topics_2d_scans': LaunchConfiguration('scan_topic_name')},
                     {'source_topics_pointclouds': LaunchConfiguration('points_topic_name')},
+                    {'topic_odometry': LaunchConfiguration('odometry_topic_name')},
                     {'show_gui': LaunchConfiguration('show_gui')},
                     {'pipeline_yaml_file': LaunchConfiguration('pipeline_yaml_file')},
                     {'filter_output_layer_name': LaunchConfiguration('filter_output_layer_name')},
                     {'time_window': LaunchConfiguration('time_window')},
                     {'topic_local_map_pointcloud': LaunchConfiguration('filter_output_topic_name')},
+                    {'topic_local_map_grid': LaunchConfiguration('grid_output_topic_name')},
                     {'frameid_reference': LaunchConfiguration('frameid_reference')},
                     {'frameid_robot': LaunchConfiguration('frameid_robot')},
                     {'one_observation_per_topic': LaunchConfiguration('one_observation_per_topic')},
+                    {'process_on_arrival': LaunchConfiguration('process_on_arrival')},
+                    {'publish_on_all_sensors_fresh': LaunchConfiguration('publish_on_all_sensors_fresh')},
+                    {'publish_every_n_scans': LaunchConfiguration('publish_every_n_scans')},
                 ],
             )
         ]
@@ -139,15 +178,20 @@ def generate_launch_description():
         container_name_arg,
         lidar_topic_name_arg,
         points_topic_name_arg,
+        odometry_topic_name_arg,
         show_gui_arg,
         time_window_arg,
         pipeline_yaml_file_arg,
         filter_output_layer_name_arg,
         filter_output_topic_arg,
+        grid_output_topic_arg,
         frameid_reference_arg,
         frameid_robot_arg,
         log_level_launch_arg,
         one_observation_per_topic_arg,
+        process_on_arrival_arg,
+        publish_on_all_sensors_fresh_arg,
+        publish_every_n_scans_arg,
         mrpt_pointcloud_pipeline_node,
         composable_mrpt_pointcloud_pipeline,
     ])
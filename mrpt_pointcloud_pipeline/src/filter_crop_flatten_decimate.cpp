@@ -0,0 +1,193 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#include <mp2p_icp_filters/GetOrCreatePointLayer.h>
+#include <mrpt/containers/yaml.h>
+#include <mrpt/core/bits_math.h>
+#include <mrpt/core/initializer.h>
+#include <mrpt_pointcloud_pipeline/filter_crop_flatten_decimate.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+IMPLEMENTS_MRPT_OBJECT(
+	FilterCropFlattenDecimate, mp2p_icp_filters::FilterBase, mrpt_pointcloud_pipeline)
+
+MRPT_INITIALIZER(register_mrpt_pointcloud_pipeline_crop_flatten_decimate)
+{
+	using mrpt::rtti::registerClass;
+	registerClass(CLASS_ID(mrpt_pointcloud_pipeline::FilterCropFlattenDecimate));
+}
+
+using namespace mrpt_pointcloud_pipeline;
+
+void FilterCropFlattenDecimate::Parameters::load_from_yaml(const mrpt::containers::yaml& c)
+{
+	MCP_LOAD_OPT(c, input_pointcloud_layer);
+	MCP_LOAD_OPT(c, output_pointcloud_layer);
+	ASSERT_(!output_pointcloud_layer.empty());
+	ASSERT_NOT_EQUAL_(input_pointcloud_layer, output_pointcloud_layer);
+
+	MCP_LOAD_OPT(c, min_z);
+	MCP_LOAD_OPT(c, max_z);
+	MCP_LOAD_OPT(c, min_range);
+	MCP_LOAD_OPT(c, max_range);
+	MCP_LOAD_OPT(c, near_range);
+	MCP_LOAD_OPT(c, near_resolution);
+	MCP_LOAD_OPT(c, far_resolution);
+	MCP_LOAD_OPT(c, flatten_to);
+	MCP_LOAD_OPT(c, closest_to_average);
+
+	ASSERT_LE_(min_z, max_z);
+	ASSERT_LE_(min_range, max_range);
+	ASSERT_GT_(near_resolution, 0);
+	ASSERT_GT_(far_resolution, 0);
+}
+
+FilterCropFlattenDecimate::FilterCropFlattenDecimate()
+{
+	mrpt::system::COutputLogger::setLoggerName("FilterCropFlattenDecimate");
+}
+
+void FilterCropFlattenDecimate::initialize(const mrpt::containers::yaml& c)
+{
+	MRPT_LOG_DEBUG_STREAM("Loading these params:\n" << c);
+	params_.load_from_yaml(c);
+}
+
+namespace
+{
+struct Cell
+{
+	uint64_t key;
+	double sx = 0, sy = 0;	//!< Sum of coordinates, then their average
+	uint32_t count = 0;
+	uint32_t best = 0;	//!< Index of the point closest to the average
+	float bestDist2 = std::numeric_limits<float>::max();
+};
+
+constexpr uint32_t NO_CELL = std::numeric_limits<uint32_t>::max();
+
+// 31 bits per coordinate, plus one bit for the near/far band, since cells of
+// both resolutions share the same table:
+uint64_t cell_key(int32_t cx, int32_t cy, bool near)
+{
+	return ((static_cast<uint64_t>(static_cast<uint32_t>(cx)) & 0x7fffffffULL) << 32) |
+		   (static_cast<uint64_t>(static_cast<uint32_t>(cy)) & 0x7fffffffULL) |
+		   (near ? (1ULL << 63) : 0ULL);
+}
+}  // namespace
+
+void FilterCropFlattenDecimate::filter(mp2p_icp::metric_map_t& inOut) const
+{
+	MRPT_START
+
+	const auto pcPtr = inOut.point_layer(params_.input_pointcloud_layer);
+	ASSERTMSG_(
+		pcPtr, mrpt::format(
+				   "Input point cloud layer '%s' was not found.",
+				   params_.input_pointcloud_layer.c_str()));
+	const auto& pc = *pcPtr;
+
+	// Output points are 2D, so no extra fields are kept:
+	auto out = mp2p_icp_filters::GetOrCreatePointLayer(
+		inOut, params_.output_pointcloud_layer, false, "mrpt::maps::CSimplePointsMap");
+
+	const auto& xs = pc.getPointsBufferRef_x();
+	const auto& ys = pc.getPointsBufferRef_y();
+	const auto& zs = pc.getPointsBufferRef_z();
+	const size_t N = pc.size();
+	if (!N) return;
+
+	const float minZ = static_cast<float>(params_.min_z);
+	const float maxZ = static_cast<float>(params_.max_z);
+	const float minR2 = static_cast<float>(mrpt::square(params_.min_range));
+	const float maxR2 = static_cast<float>(mrpt::square(params_.max_range));
+	const float nearR2 = static_cast<float>(mrpt::square(params_.near_range));
+	const float invNearRes = static_cast<float>(1.0 / params_.near_resolution);
+	const float invFarRes = static_cast<float>(1.0 / params_.far_resolution);
+
+	// Flat open-addressing hash table (linear probing) of indices into
+	// `cells`, with a load factor <=0.5:
+	unsigned int log2Size = 4;
+	while ((size_t(1) << log2Size) < 2 * N) log2Size++;
+	const size_t tableMask = (size_t(1) << log2Size) - 1;
+	std::vector<uint32_t> table(tableMask + 1, NO_CELL);
+
+	std::vector<Cell> cells;
+	std::vector<uint32_t> cellOfPoint;
+	if (params_.closest_to_average) cellOfPoint.assign(N, NO_CELL);
+
+	// Pass 1: crop, and bin into 2D cells:
+	for (size_t i = 0; i < N; i++)
+	{
+		const float x = xs[i], y = ys[i], z = zs[i];
+		if (z < minZ || z > maxZ) continue;
+
+		const float r2 = x * x + y * y;
+		if (r2 < minR2 || r2 > maxR2) continue;
+
+		const bool near = r2 < nearR2;
+		const float invRes = near ? invNearRes : invFarRes;
+		const uint64_t key = cell_key(
+			static_cast<int32_t>(std::floor(x * invRes)),
+			static_cast<int32_t>(std::floor(y * invRes)), near);
+
+		// Fibonacci hashing:
+		size_t h = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> (64 - log2Size));
+		while (table[h] != NO_CELL && cells[table[h]].key != key) h = (h + 1) & tableMask;
+
+		if (table[h] == NO_CELL)
+		{
+			table[h] = static_cast<uint32_t>(cells.size());
+			cells.emplace_back().key = key;
+		}
+		auto& c = cells[table[h]];
+		c.sx += x;
+		c.sy += y;
+		c.count++;
+		if (!cellOfPoint.empty()) cellOfPoint[i] = table[h];
+	}
+
+	for (auto& c : cells)
+	{
+		c.sx /= c.count;
+		c.sy /= c.count;
+	}
+
+	// Pass 2 (optional): find the point closest to each cell average:
+	if (!cellOfPoint.empty())
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			if (cellOfPoint[i] == NO_CELL) continue;
+			auto& c = cells[cellOfPoint[i]];
+			const float d2 =
+				static_cast<float>(mrpt::square(xs[i] - c.sx) + mrpt::square(ys[i] - c.sy));
+			if (d2 < c.bestDist2)
+			{
+				c.bestDist2 = d2;
+				c.best = static_cast<uint32_t>(i);
+			}
+		}
+	}
+
+	const float flattenZ = static_cast<float>(params_.flatten_to);
+	out->reserve(out->size() + cells.size());
+	for (const auto& c : cells)
+	{
+		if (params_.closest_to_average)
+			out->insertPoint(xs[c.best], ys[c.best], flattenZ);
+		else
+			out->insertPoint(static_cast<float>(c.sx), static_cast<float>(c.sy), flattenZ);
+	}
+
+	MRPT_END
+}
@@ -0,0 +1,300 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#include <mp2p_icp_filters/GetOrCreatePointLayer.h>
+#include <mrpt/containers/yaml.h>
+#include <mrpt/core/initializer.h>
+#include <mrpt/version.h>
+#include <mrpt_pointcloud_pipeline/filter_ground_segmentation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+IMPLEMENTS_MRPT_OBJECT(
+	FilterGroundSegmentation, mp2p_icp_filters::FilterBase, mrpt_pointcloud_pipeline)
+
+MRPT_INITIALIZER(register_mrpt_pointcloud_pipeline_filters)
+{
+	using mrpt::rtti::registerClass;
+	registerClass(CLASS_ID(mrpt_pointcloud_pipeline::FilterGroundSegmentation));
+}
+
+using namespace mrpt_pointcloud_pipeline;
+
+void FilterGroundSegmentation::Parameters::load_from_yaml(const mrpt::containers::yaml& c)
+{
+	MCP_LOAD_OPT(c, input_pointcloud_layer);
+	MCP_LOAD_OPT(c, obstacles_layer);
+	MCP_LOAD_OPT(c, ground_layer);
+	ASSERTMSG_(
+		!obstacles_layer.empty() || !ground_layer.empty(),
+		"At least one of 'obstacles_layer' or 'ground_layer' must be given");
+
+	MCP_LOAD_OPT_DEG(c, max_slope);
+	MCP_LOAD_OPT(c, ground_threshold);
+	MCP_LOAD_OPT(c, max_ground_step);
+	MCP_LOAD_OPT(c, use_rings);
+	MCP_LOAD_OPT(c, azimuth_sectors);
+	MCP_LOAD_OPT(c, grid_cell_size);
+	MCP_LOAD_OPT(c, grid_plane_band);
+	MCP_LOAD_OPT(c, grid_max_ground_z);
+
+	ASSERT_GT_(azimuth_sectors, 0U);
+	ASSERT_GT_(grid_cell_size, 0);
+}
+
+FilterGroundSegmentation::FilterGroundSegmentation()
+{
+	mrpt::system::COutputLogger::setLoggerName("FilterGroundSegmentation");
+}
+
+void FilterGroundSegmentation::initialize(const mrpt::containers::yaml& c)
+{
+	MRPT_LOG_DEBUG_STREAM("Loading these params:\n" << c);
+	params_.load_from_yaml(c);
+}
+
+void FilterGroundSegmentation::filter(mp2p_icp::metric_map_t& inOut) const
+{
+	MRPT_START
+
+	const auto pcPtr = inOut.point_layer(params_.input_pointcloud_layer);
+	ASSERTMSG_(
+		pcPtr, mrpt::format(
+				   "Input point cloud layer '%s' was not found.",
+				   params_.input_pointcloud_layer.c_str()));
+	const auto& pc = *pcPtr;
+
+	// Outputs have the same class than the input, to keep extra fields:
+	const std::string className = pc.GetRuntimeClass()->className;
+	mrpt::maps::CPointsMap::Ptr outObstacles, outGround;
+	if (!params_.obstacles_layer.empty())
+		outObstacles = mp2p_icp_filters::GetOrCreatePointLayer(
+			inOut, params_.obstacles_layer, false, className);
+	if (!params_.ground_layer.empty())
+		outGround =
+			mp2p_icp_filters::GetOrCreatePointLayer(inOut, params_.ground_layer, false, className);
+
+	const mrpt::aligned_std_vector<uint16_t>* rings = nullptr;
+#if MRPT_VERSION >= 0x020b04
+	if (params_.use_rings) rings = pc.getPointsBufferRef_ring();
+	if (rings && rings->size() != pc.size()) rings = nullptr;
+#endif
+
+	const std::vector<bool> isGround = rings ? segment_rings(pc, *rings) : segment_grid(pc);
+
+	if (outObstacles) outObstacles->reserve(outObstacles->size() + pc.size());
+	if (outGround) outGround->reserve(outGround->size() + pc.size());
+
+	for (size_t i = 0; i < pc.size(); i++)
+	{
+		auto& out = isGround[i] ? outGround : outObstacles;
+		if (out) out->insertPointFrom(pc, i);
+	}
+
+	MRPT_END
+}
+
+std::vector<bool> FilterGroundSegmentation::segment_rings(
+	const mrpt::maps::CPointsMap& pc, const mrpt::aligned_std_vector<uint16_t>& rings) const
+{
+	const auto& xs = pc.getPointsBufferRef_x();
+	const auto& ys = pc.getPointsBufferRef_y();
+	const auto& zs = pc.getPointsBufferRef_z();
+	const size_t N = pc.size();
+	const size_t nCols = params_.azimuth_sectors;
+
+	std::vector<bool> isGround(N, false);
+	if (!N) return isGround;
+
+	// Rings are numbered by elevation, either upwards or downwards depending
+	// on the sensor vendor: find out which one, from the mean elevation of
+	// the first and last rings:
+	const size_t nRings = 1 + *std::max_element(rings.begin(), rings.end());
+	std::vector<double> sumElev(nRings, 0);
+	std::vector<size_t> ringCount(nRings, 0);
+	for (size_t i = 0; i < N; i++)
+	{
+		sumElev[rings[i]] += std::atan2(zs[i], std::hypot(xs[i], ys[i]));
+		ringCount[rings[i]]++;
+	}
+	const auto firstRing = std::distance(
+		ringCount.begin(),
+		std::find_if(ringCount.begin(), ringCount.end(), [](size_t n) { return n > 0; }));
+	const auto lastRing = nRings - 1;
+	const bool ringsUpwards = sumElev[firstRing] / ringCount[firstRing] <=
+							  sumElev[lastRing] / ringCount[lastRing];
+
+	// Counting sort: by azimuth column, then by elevation within each column.
+	// 1) Order by elevation (rank of the ring):
+	std::vector<size_t> ringStart(nRings + 1, 0);
+	for (size_t r = 0; r < nRings; r++)
+	{
+		const size_t rank = ringsUpwards ? r : nRings - 1 - r;
+		ringStart[rank + 1] = ringCount[r];
+	}
+	for (size_t r = 0; r < nRings; r++) ringStart[r + 1] += ringStart[r];
+
+	std::vector<uint32_t> byElev(N);
+	for (size_t i = 0; i < N; i++)
+	{
+		const size_t rank = ringsUpwards ? rings[i] : nRings - 1 - rings[i];
+		byElev[ringStart[rank]++] = static_cast<uint32_t>(i);
+	}
+
+	// 2) Stable sort by azimuth column:
+	std::vector<uint32_t> col(N);
+	std::vector<size_t> colStart(nCols + 1, 0);
+	for (size_t i = 0; i < N; i++)
+	{
+		const double a = (std::atan2(ys[i], xs[i]) + M_PI) / (2 * M_PI);
+		col[i] = std::min<uint32_t>(nCols - 1, static_cast<uint32_t>(a * nCols));
+		colStart[col[i] + 1]++;
+	}
+	for (size_t c = 0; c < nCols; c++) colStart[c + 1] += colStart[c];
+
+	std::vector<uint32_t> sorted(N);
+	{
+		std::vector<size_t> next(colStart.begin(), colStart.end() - 1);
+		for (const auto i : byElev) sorted[next[col[i]]++] = i;
+	}
+
+	// Walk each column upwards in elevation (i.e. outwards on the ground),
+	// from the ground under the robot:
+	const double maxSlopeTan = std::tan(params_.max_slope);
+	for (size_t c = 0; c < nCols; c++)
+	{
+		double lastR = 0, lastZ = 0;
+		for (size_t k = colStart[c]; k < colStart[c + 1]; k++)
+		{
+			const auto i = sorted[k];
+			const double r = std::hypot(xs[i], ys[i]);
+			const double dr = std::max(.0, r - lastR);
+			const double maxRise = std::min(maxSlopeTan * dr, params_.max_ground_step);
+			const double dz = std::abs(zs[i] - lastZ);
+			if (dz > maxRise + params_.ground_threshold) continue;
+
+			isGround[i] = true;
+
+			// Only points along the terrain slope move the reference, so the
+			// tolerance does not accumulate ring by ring up a vertical wall:
+			if (dz > maxSlopeTan * dr) continue;
+			lastR = r;
+			lastZ = zs[i];
+		}
+	}
+	return isGround;
+}
+
+std::vector<bool> FilterGroundSegmentation::segment_grid(const mrpt::maps::CPointsMap& pc) const
+{
+	const auto& xs = pc.getPointsBufferRef_x();
+	const auto& ys = pc.getPointsBufferRef_y();
+	const auto& zs = pc.getPointsBufferRef_z();
+	const size_t N = pc.size();
+	const double res = params_.grid_cell_size;
+
+	struct Cell
+	{
+		float minZ = std::numeric_limits<float>::max();
+		// Sums for the least-squares plane z=a*dx+b*dy+c, with (dx,dy)
+		// relative to the cell center:
+		double n = 0, sx = 0, sy = 0, sz = 0, sxx = 0, sxy = 0, syy = 0, sxz = 0, syz = 0;
+		double a = 0, b = 0, c = 0;
+		bool hasGround = false;
+	};
+	std::unordered_map<uint64_t, Cell> cells;
+	std::vector<Cell*> cellOf(N);
+	std::vector<double> dxs(N), dys(N);
+
+	// Pass 1: lowest point per cell:
+	for (size_t i = 0; i < N; i++)
+	{
+		const auto cx = static_cast<int32_t>(std::floor(xs[i] / res));
+		const auto cy = static_cast<int32_t>(std::floor(ys[i] / res));
+		const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+							 static_cast<uint32_t>(cy);
+		Cell& cell = cells[key];
+		cell.minZ = std::min(cell.minZ, zs[i]);
+		cellOf[i] = &cell;
+		dxs[i] = xs[i] - (cx + 0.5) * res;
+		dys[i] = ys[i] - (cy + 0.5) * res;
+	}
+
+	// Pass 2: plane fit to the lowest points of each cell:
+	for (size_t i = 0; i < N; i++)
+	{
+		Cell& cell = *cellOf[i];
+		if (zs[i] > cell.minZ + params_.grid_plane_band) continue;
+		const double x = dxs[i], y = dys[i], z = zs[i];
+		cell.n++;
+		cell.sx += x;
+		cell.sy += y;
+		cell.sz += z;
+		cell.sxx += x * x;
+		cell.sxy += x * y;
+		cell.syy += y * y;
+		cell.sxz += x * z;
+		cell.syz += y * z;
+	}
+
+	const double maxSlopeTan = std::tan(params_.max_slope);
+	for (auto& kv : cells)
+	{
+		Cell& cell = kv.second;
+		cell.hasGround = cell.minZ <= params_.grid_max_ground_z;
+		if (!cell.hasGround) continue;
+
+		// Default: horizontal plane at the mean height of the lowest points:
+		cell.c = cell.sz / cell.n;
+
+		// Normal equations, solved by Cramer's rule:
+		const double m[3][3] = {
+			{cell.sxx, cell.sxy, cell.sx},
+			{cell.sxy, cell.syy, cell.sy},
+			{cell.sx, cell.sy, cell.n}};
+		const double v[3] = {cell.sxz, cell.syz, cell.sz};
+		const auto det3 = [](const double A[3][3])
+		{
+			return A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) -
+				   A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) +
+				   A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+		};
+		const double det = det3(m);
+		if (cell.n < 3 || std::abs(det) < 1e-9) continue;
+
+		double sol[3];
+		for (int k = 0; k < 3; k++)
+		{
+			double mk[3][3];
+			for (int r = 0; r < 3; r++)
+				for (int cc = 0; cc < 3; cc++) mk[r][cc] = (cc == k) ? v[r] : m[r][cc];
+			sol[k] = det3(mk) / det;
+		}
+
+		// Too steep to be ground: keep the horizontal plane.
+		if (std::hypot(sol[0], sol[1]) > maxSlopeTan) continue;
+
+		cell.a = sol[0];
+		cell.b = sol[1];
+		cell.c = sol[2];
+	}
+
+	// Pass 3: classify:
+	std::vector<bool> isGround(N, false);
+	for (size_t i = 0; i < N; i++)
+	{
+		const Cell& cell = *cellOf[i];
+		if (!cell.hasGround) continue;
+		const double zPlane = cell.a * dxs[i] + cell.b * dys[i] + cell.c;
+		isGround[i] = std::abs(zs[i] - zPlane) <= params_.ground_threshold;
+	}
+	return isGround;
+}
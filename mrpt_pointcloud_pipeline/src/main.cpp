@@ -15,7 +15,11 @@ int main(int argc, char** argv)
 
 	auto node = std::make_shared<LocalObstaclesNode>();
 
-	rclcpp::spin(node->get_node_base_interface());
+	// Multi-threaded executor, so sensors are processed as they arrive, in
+	// parallel with the publish timer (see the node callback groups):
+	rclcpp::executors::MultiThreadedExecutor executor;
+	executor.add_node(node->get_node_base_interface());
+	executor.spin();
 
 	rclcpp::shutdown();
 
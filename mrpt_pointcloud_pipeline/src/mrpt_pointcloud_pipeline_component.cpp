@@ -8,8 +8,12 @@
 
 #include <mrpt/ros2bridge/time.h>
 #include <mrpt_pointcloud_pipeline/mrpt_pointcloud_pipeline_node.h>
+#include <mrpt_pointcloud_pipeline/points_to_ros.h>
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
+#include <thread>
 
 // for now, not needed (node=executable)
 #include "rclcpp_components/register_node_macro.hpp"
@@ -19,6 +23,7 @@ using namespace mrpt::config;
 using namespace mrpt::img;
 using namespace mrpt::maps;
 using namespace mrpt::obs;
+using mrpt_pointcloud_pipeline::points_to_ros;
 
 LocalObstaclesNode::LocalObstaclesNode(const rclcpp::NodeOptions& options)
 	:Node("mrpt_pointcloud_pipeline_node", options)
@@ -27,18 +32,52 @@ LocalObstaclesNode::LocalObstaclesNode(const rclcpp::NodeOptions& options)
 
 	read_parameters();
 
+	// Create the tf2 buffer and listener
+	m_tf_buffer = std::make_shared<tf2_ros::Buffer>(this->get_clock());
+	m_tf_listener = std::make_shared<tf2_ros::TransformListener>(*m_tf_buffer);
+
+	// Sensors are processed as they arrive, in parallel and independently of
+	// the publish timer (requires a multi-threaded executor):
+	m_cb_group_sensors = create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+	m_cb_group_publish = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+
+	rclcpp::SubscriptionOptions sensorSubOpts;
+	sensorSubOpts.callback_group = m_cb_group_sensors;
+
+	// Intra-process delivery only for the raw sensor data, so it can be
+	// enabled without the node-wide use_intra_process_comms option:
+	auto rawSensorSubOpts = sensorSubOpts;
+	rawSensorSubOpts.use_intra_process_comm = rclcpp::IntraProcessSetting::Enable;
+
+	// Source of robot poses: odometry, or periodic sampling of /tf:
+	if (!m_topic_odometry.empty())
+	{
+		m_sub_odometry = this->create_subscription<nav_msgs::msg::Odometry>(
+			m_topic_odometry, 100,
+			[this](const nav_msgs::msg::Odometry::SharedPtr odo) { this->on_odometry(odo); },
+			sensorSubOpts);
+	}
+	else
+	{
+		m_timer_tf_sample = create_wall_timer(
+			std::chrono::duration<double>(m_tf_sample_period),
+			[this]() { this->sample_robot_pose_from_tf(); }, m_cb_group_sensors);
+	}
+
 	// Init ROS subs:
 	// Subscribe to one or more laser sources:
 	size_t nSubsTotal = 0;
 	nSubsTotal += subscribe_to_multiple_topics<sensor_msgs::msg::LaserScan>(
 		m_topics_source_2dscan, m_subs_2dlaser,
 		[this](const sensor_msgs::msg::LaserScan::SharedPtr scan, const std::string& topicName)
-		{ this->on_new_sensor_laser_2d(scan, topicName); });
+		{ this->on_new_sensor_laser_2d(scan, topicName); },
+		rawSensorSubOpts);
 
 	nSubsTotal += subscribe_to_multiple_topics<sensor_msgs::msg::PointCloud2>(
 		m_topics_source_pointclouds, m_subs_pointclouds,
 		[this](const sensor_msgs::msg::PointCloud2::SharedPtr pts, const std::string& topicName)
-		{ this->on_new_sensor_pointcloud(pts, topicName); });
+		{ this->on_new_sensor_pointcloud(pts, topicName); },
+		rawSensorSubOpts);
 
 	RCLCPP_INFO(
 		get_logger(), "Total number of sensor subscriptions: %u",
@@ -54,61 +93,79 @@ LocalObstaclesNode::LocalObstaclesNode(const rclcpp::NodeOptions& options)
 		rclcpp::shutdown();
 	}
 
-	// Create the tf2 buffer and listener
-	m_tf_buffer = std::make_shared<tf2_ros::Buffer>(this->get_clock());
-	m_tf_listener = std::make_shared<tf2_ros::TransformListener>(*m_tf_buffer);
-
 	m_timer_publish = create_wall_timer(
-		std::chrono::duration<double>(m_publish_period), [this]() { this->on_do_publish(); });
+		std::chrono::duration<double>(m_publish_period), [this]() { this->on_do_publish(); },
+		m_cb_group_publish);
+
+	// Pipeline hot reload, on file changes or on a new pipeline_yaml_file:
+	if (m_pipeline_watch_period > 0)
+	{
+		m_timer_pipeline_watch = create_wall_timer(
+			std::chrono::duration<double>(m_pipeline_watch_period),
+			[this]() { this->check_pipeline_file_modified(); }, m_cb_group_sensors);
+	}
+
+	m_on_set_params_handle = add_on_set_parameters_callback(
+		[this](const std::vector<rclcpp::Parameter>& params)
+		{
+			rcl_interfaces::msg::SetParametersResult result;
+			result.successful = true;
+			for (const auto& p : params)
+			{
+				if (p.get_name() != "pipeline_yaml_file") continue;
+
+				const std::string file = p.as_string();
+				if (!mrpt::system::fileExists(file))
+				{
+					result.successful = false;
+					result.reason = "File not found: " + file;
+					return result;
+				}
+				{
+					auto lck = mrpt::lockHelper(m_pipeline_reload_mtx);
+					m_pipeline_yaml_file = file;
+					m_pipeline_file_mtime = mrpt::system::getFileModificationTime(file);
+				}
+				request_pipeline_reload();
+			}
+			return result;
+		});
 }  // end ctor
 
 /** Callback: On recalc local map & publish it */
 void LocalObstaclesNode::on_do_publish()
 {
+	auto lckPublish = mrpt::lockHelper(m_publish_mtx);
+
+	// Swap in a reloaded pipeline, if any, between publishes:
+	const bool reloaded = apply_pending_pipelines();
+
+	// Skip if no new observation arrived since the last local map, since it
+	// would be identical, unless the obstacle memory has to decay:
+	const uint64_t head = m_hist_obs.head();
+	const bool newObs = head != m_publish_triggers.last_head();
+	if (!newObs && !reloaded && (m_memory_source_layer.empty() || !m_memory.size())) return;
+
 	CTimeLoggerEntry tle(m_profiler, "on_do_publish");
 
-	// Purge old observations & latch a local copy:
-	obs_list_t obs;
+	// Snapshot of the history, keeping only entries within the time window.
+	// Entries committed after reading `head` above are also included, so
+	// keep the head of the snapshot itself:
+	mrpt_pointcloud_pipeline::ObservationList windowObs;
+	uint64_t snapshotHead = head;
 	{
-		CTimeLoggerEntry tle(m_profiler, "onDoPublish.removingOld");
-		m_hist_obs_mtx.lock();
+		CTimeLoggerEntry tle(m_profiler, "on_do_publish.snapshot");
 
-		// Purge old obs:
-		if (!m_hist_obs.empty())
-		{
-			const double last_time = m_hist_obs.rbegin()->first;
-			obs_list_t::iterator it_first_valid = m_hist_obs.lower_bound(last_time - m_time_window);
-			const size_t nToRemove = std::distance(m_hist_obs.begin(), it_first_valid);
-			RCLCPP_DEBUG(
-				get_logger(), "[onDoPublish] Removing %u old entries, last_time=%lf",
-				static_cast<unsigned int>(nToRemove), last_time);
-			m_hist_obs.erase(m_hist_obs.begin(), it_first_valid);
-		}
-		// Local copy in this thread:
-		obs = m_hist_obs;
-		m_hist_obs_mtx.unlock();
+		// Sorted by sensor timestamp (insertion order is arrival order):
+		windowObs = mrpt_pointcloud_pipeline::select_time_window(
+			m_hist_obs.snapshot(&snapshotHead), m_time_window);
 	}
 
-	// Keep only one obs per topic?
-	if (m_one_observation_per_topic)
-	{
-		// TODO(jlbc): Remove in reverse order to keep the latest one!
-		std::set<std::string> foundTopics;
-		for (auto it = obs.begin(); it != obs.end();)
-		{
-			const auto& topic = it->second.sourceTopic;
-			if (foundTopics.count(topic) != 0)
-			{
-				// duplicated entry, delete:
-				it = obs.erase(it);
-			}
-			else
-			{
-				foundTopics.insert(topic);
-				++it;  // move on:
-			}
-		}
-	}
+	// Keep only one obs per topic? All of them are still inserted into the
+	// obstacle memory:
+	const auto obs = m_one_observation_per_topic
+						 ? mrpt_pointcloud_pipeline::latest_per_topic(windowObs)
+						 : windowObs;
 
 	RCLCPP_DEBUG(
 		get_logger(), "Building local map with %u observations.",
@@ -124,25 +181,12 @@ void LocalObstaclesNode::on_do_publish()
 	{
 		CTimeLoggerEntry tle2(m_profiler, "on_do_publish.buildLocalMap");
 
-		// Get the latest robot pose in the reference frame (typ: /odom ->
-		// /base_link)
-		// so we can build the local map RELATIVE to it:
-
-		try
-		{
-			geometry_msgs::msg::TransformStamped tx;
-			tx = m_tf_buffer->lookupTransform(
-				m_frameid_reference, m_frameid_robot, tf2::TimePointZero);
-
-			tf2::Transform tfx;
-			tf2::fromMsg(tx.transform, tfx);
-			curRobotPose = mrpt::ros2bridge::fromROS(tfx);
-		}
-		catch (const tf2::ExtrapolationException& ex)
-		{
-			RCLCPP_ERROR(get_logger(), "%s", ex.what());
-			return;
-		}
+		// Get the robot pose in the reference frame (typ: /odom -> /base_link)
+		// at the time of the latest observation, so we can build the local map
+		// RELATIVE to it:
+		const auto pose = get_robot_pose(obs.back()->timestamp);
+		if (!pose) return;
+		curRobotPose = *pose;
 
 		RCLCPP_DEBUG(
 			get_logger(),
@@ -150,26 +194,53 @@ void LocalObstaclesNode::on_do_publish()
 			"pose: %s",
 			curRobotPose.asString().c_str());
 
-		// For each observation: compute relative robot pose & insert obs
-		// into map:
-		for (const auto& [timestamp, ipt] : obs)
+		// Run the per-observation pipeline for new entries, in parallel if
+		// there is a worker pool:
 		{
-			// Relative pose in the past:
-			const mrpt::poses::CPose3D relPose = ipt.robot_pose - curRobotPose;
+			CTimeLoggerEntry tleObs(m_profiler, "on_do_publish.apply_per_obs_pipeline");
 
-			// Insert obs:
-			CTimeLoggerEntry tleObsFilter(m_profiler, "on_do_publish.apply_per_obs_pipeline");
-
-			// Apply optional generators for auxiliary map layers, etc:
-			mp2p_icp_filters::apply_generators(m_generator, *ipt.observation, mm);
+			std::vector<std::future<void>> tasks;
+			for (const auto& ipt : obs)
+			{
+				const auto& p = *ipt->processed;
+				if (p.map && p.pipeline_version == m_pipeline_version) continue;  // Already done
+
+				if (m_workers)
+					tasks.emplace_back(
+						m_workers->enqueue([this, ipt]() { get_processed_observation(*ipt); }));
+				else
+					get_processed_observation(*ipt);
+			}
+			for (auto& t : tasks) t.get();	// (re)throws worker exceptions, if any
+		}
 
-			// per-observation filtering:
-			mp2p_icp_filters::apply_filter_pipeline(m_per_obs_pipeline, mm);
+		// Merge their outputs into the local map, in timestamp order, so the
+		// result does not depend on which worker finished first:
+		CTimeLoggerEntry tleMerge(m_profiler, "on_do_publish.merge_obs");
+		mrpt_pointcloud_pipeline::merge_observations(obs, curRobotPose, mm);
+	}
 
-			tleObsFilter.stop();
-		}
+	if (!m_memory_source_layer.empty())
+	{
+		CTimeLoggerEntry tleMem(m_profiler, "on_do_publish.update_memory");
+
+		// Without new observations, the memory keeps decaying with the time
+		// elapsed since the last one arrived (by the node clock, which may be
+		// offset from the sensor clocks):
+		const double nodeNow = mrpt::Clock::toDouble(mrpt::ros2bridge::fromROS(this->now()));
+		if (newObs) m_memory_last_new_obs_clock = nodeNow;
+		const double decayTime = obs.back()->timestamp + (nodeNow - m_memory_last_new_obs_clock);
+
+		// Entries not used for the local map (one_observation_per_topic) may
+		// not be processed yet:
+		mm.layers[m_memory_output_layer] = mrpt_pointcloud_pipeline::update_memory(
+			m_memory, windowObs, m_memory_source_layer, decayTime, curRobotPose,
+			[this](const InfoPerTimeStep& ipt) -> const mp2p_icp::metric_map_t&
+			{ return get_processed_observation(ipt); });
 	}
 
+	m_publish_triggers.on_local_map(snapshotHead, obs.back()->timestamp);
+
 	// Apply final filtering:
 	CTimeLoggerEntry tleFilter(m_profiler, "on_do_publish.apply_final_pipeline");
 
@@ -182,24 +253,44 @@ void LocalObstaclesNode::on_do_publish()
 	{
 		if (e.pub->get_subscription_count() == 0) continue;
 
-		sensor_msgs::msg::PointCloud2 msg_pts;
-		msg_pts.header.frame_id = m_frameid_robot;
-
-		// Publish using the timestamp of the *latest* observation:
-		msg_pts.header.stamp =
-			mrpt::ros2bridge::toROS(mrpt::Clock::fromDouble(obs.rbegin()->first));
+		CTimeLoggerEntry tlePub(m_profiler, "on_do_publish.publish_layer");
 
 		const auto& outPtsMap = mm.point_layer(e.layer);
 		ASSERT_(outPtsMap);
 
-		// TODO(jlbc): We could add an if-else chain if XYZI / XYZIRT point
-		// clouds are desired as output too, but it seems not likely for this
-		// kind of filtering node.
-		auto simplPts = std::dynamic_pointer_cast<mrpt::maps::CSimplePointsMap>(outPtsMap);
-		ASSERT_(simplPts);
+		std_msgs::msg::Header header;
+		header.frame_id = m_frameid_robot;
+		// Publish using the timestamp of the *latest* observation:
+		header.stamp = mrpt::ros2bridge::toROS(mrpt::Clock::fromDouble(obs.back()->timestamp));
 
-		mrpt::ros2bridge::toROS(*simplPts, msg_pts.header, msg_pts);
-		e.pub->publish(msg_pts);
+		if (e.pub->can_loan_messages())
+		{
+			// Serialize directly into middleware-owned memory:
+			auto loaned = e.pub->borrow_loaned_message();
+			points_to_ros(*outPtsMap, header, loaned.get());
+			e.pub->publish(std::move(loaned));
+		}
+		else if (e.pub->get_intra_process_subscription_count() > 0)
+		{
+			// Publish as a unique_ptr, so intra-process subscribers (e.g. when
+			// composed in the same container) take ownership with no copies:
+			auto msg_pts = std::make_unique<sensor_msgs::msg::PointCloud2>();
+			points_to_ros(*outPtsMap, header, *msg_pts);
+			e.pub->publish(std::move(msg_pts));
+		}
+		else
+		{
+			// Inter-process only: reuse the same buffer (and its memory) in
+			// each publish, since it is only serialized:
+			points_to_ros(*outPtsMap, header, e.msg_buffer);
+			e.pub->publish(e.msg_buffer);
+		}
+	}
+
+	if (m_pub_grid && m_pub_grid->get_subscription_count() > 0)
+	{
+		CTimeLoggerEntry tleGrid(m_profiler, "on_do_publish.obstacle_grid");
+		publish_obstacle_grid(mm, curRobotPose, obs.back()->timestamp);
 	}
 
 	// Show gui:
@@ -276,7 +367,7 @@ void LocalObstaclesNode::on_do_publish()
 
 		for (const auto& o : obs)
 		{
-			const InfoPerTimeStep& ipt = o.second;
+			const InfoPerTimeStep& ipt = *o;
 			// Relative pose in the past:
 			mrpt::poses::CPose3D relPose(mrpt::poses::UNINITIALIZED_POSE);
 			relPose.inverseComposeFrom(ipt.robot_pose, curRobotPose);
@@ -309,88 +400,304 @@ void LocalObstaclesNode::on_do_publish()
 
 }  // onDoPublish
 
-void LocalObstaclesNode::on_new_sensor_laser_2d(
-	const sensor_msgs::msg::LaserScan::SharedPtr& scan, const std::string& topicName)
+void LocalObstaclesNode::publish_obstacle_grid(
+	const mp2p_icp::metric_map_t& mm, const mrpt::poses::CPose3D& robotPose, double stamp)
 {
-	CTimeLoggerEntry tle(m_profiler, "on_new_sensor_laser_2d");
+	const auto pts = mm.point_layer(m_grid_layer);
+	ASSERT_(pts);
 
-	geometry_msgs::msg::TransformStamped sensorOnRobot;
-	try
+	m_obstacle_grid.recenter(robotPose.x(), robotPose.y());
+
+	// Local map points are relative to the robot: move them to the
+	// reference frame, where the grid is defined:
+	const auto& lxs = pts->getPointsBufferRef_x();
+	const auto& lys = pts->getPointsBufferRef_y();
+	const auto& lzs = pts->getPointsBufferRef_z();
+
+	std::vector<float> xs(lxs.size()), ys(lxs.size());
+	for (size_t i = 0; i < lxs.size(); i++)
 	{
-		CTimeLoggerEntry tle2(m_profiler, "onNewSensor_Laser2D.lookupTransform_sensor");
-		sensorOnRobot = m_tf_buffer->lookupTransform(
-			m_frameid_robot, scan->header.frame_id, tf2::TimePointZero);
+		float gz;
+		robotPose.composePoint(lxs[i], lys[i], lzs[i], xs[i], ys[i], gz);
 	}
-	catch (const tf2::TransformException& ex)
+
+	auto msg = std::make_unique<nav_msgs::msg::OccupancyGrid>();
+	msg->header.frame_id = m_frameid_reference;
+	msg->header.stamp = mrpt::ros2bridge::toROS(mrpt::Clock::fromDouble(stamp));
+	msg->info.map_load_time = msg->header.stamp;
+	msg->info.resolution = static_cast<float>(m_obstacle_grid.resolution());
+	msg->info.width = msg->info.height = static_cast<uint32_t>(m_obstacle_grid.size());
+	msg->info.origin.position.x = m_obstacle_grid.origin_cx() * m_obstacle_grid.resolution();
+	msg->info.origin.position.y = m_obstacle_grid.origin_cy() * m_obstacle_grid.resolution();
+	msg->info.origin.orientation.w = 1.0;
+	m_obstacle_grid.rasterize(xs, ys, robotPose.x(), robotPose.y(), msg->data);
+
+	m_pub_grid->publish(std::move(msg));
+}
+
+const mp2p_icp::metric_map_t& LocalObstaclesNode::get_processed_observation(
+	const InfoPerTimeStep& ipt)
+{
+	ASSERT_(ipt.processed);
+	auto& p = *ipt.processed;
+	if (p.map && p.pipeline_version == m_pipeline_version) return *p.map;  // Already done
+
+	// Get a pipeline instance not in use by any other thread, waiting for
+	// one to be released if needed:
+	struct PipelineLease
 	{
-		RCLCPP_ERROR(get_logger(), "%s", ex.what());
-		return;
+		LocalObstaclesNode& node;
+		size_t idx;
+		uint64_t version;  //!< Pipeline version of this instance
+
+		explicit PipelineLease(LocalObstaclesNode& n) : node(n)
+		{
+			std::unique_lock<std::mutex> lck(node.m_free_per_obs_pipelines_mtx);
+			node.m_free_per_obs_pipelines_cv.wait(
+				lck, [this]() { return !node.m_free_per_obs_pipelines.empty(); });
+			idx = node.m_free_per_obs_pipelines.back();
+			node.m_free_per_obs_pipelines.pop_back();
+			version = node.m_pipeline_version;
+		}
+		~PipelineLease()
+		{
+			{
+				auto lck = mrpt::lockHelper(node.m_free_per_obs_pipelines_mtx);
+				node.m_free_per_obs_pipelines.push_back(idx);
+			}
+			// Wake up all: waiting workers, and apply_pending_pipelines()
+			node.m_free_per_obs_pipelines_cv.notify_all();
+		}
+	};
+	const PipelineLease lease(*this);
+	auto& pl = m_per_obs_pipelines.at(lease.idx);
+
+	auto m = mp2p_icp::metric_map_t::Create();
+
+	// Apply optional generators for auxiliary map layers, etc:
+	mp2p_icp_filters::apply_generators(pl.generator, *ipt.observation, *m);
+
+	// per-observation filtering:
+	mp2p_icp_filters::apply_filter_pipeline(pl.pipeline, *m);
+
+	p.pipeline_version = lease.version;
+	p.map = m;
+	return *p.map;
+}
+
+LocalObstaclesNode::PipelineSet LocalObstaclesNode::load_pipelines(
+	const std::string& yamlFile, size_t numInstances) const
+{
+	ASSERT_FILE_EXISTS_(yamlFile);
+	ASSERT_GT_(numInstances, 0U);
+
+	const mrpt::containers::yaml cfg = mrpt::containers::yaml::FromFile(yamlFile);
+
+	RCLCPP_DEBUG_STREAM(get_logger(), cfg);
+
+	ASSERT_(cfg.has("generators"));
+	ASSERT_(cfg.has("per_observation"));
+	ASSERT_(cfg.has("final"));
+
+	PipelineSet ps;
+	ps.per_obs.resize(numInstances);
+	for (auto& pl : ps.per_obs)
+	{
+		pl.generator = mp2p_icp_filters::generators_from_yaml(cfg["generators"]);
+		pl.pipeline = mp2p_icp_filters::filter_pipeline_from_yaml(cfg["per_observation"]);
 	}
+	ps.final = mp2p_icp_filters::filter_pipeline_from_yaml(cfg["final"]);
+
+	return ps;
+}
+
+void LocalObstaclesNode::validate_pipelines(PipelineSet& ps) const
+{
+	ASSERT_(!ps.per_obs.empty());
+
+	// Test with the latest observation, if any:
+	std::shared_ptr<const InfoPerTimeStep> latest;
+	for (const auto& ipt : m_hist_obs.snapshot())
+		if (!latest || ipt->timestamp > latest->timestamp) latest = ipt;
+
+	if (!latest) return;  // Nothing to test with yet.
 
-	const mrpt::poses::CPose3D sensorOnRobot_mrpt = [&]()
+	// Use a deep copy of the observation, since sensor threads and publish
+	// workers may be running the current pipelines on it at the same time:
+	const auto obs =
+		std::dynamic_pointer_cast<CObservation>(latest->observation->duplicateGetSmartPtr());
+	ASSERT_(obs);
+	if (auto pc = std::dynamic_pointer_cast<CObservationPointCloud>(obs); pc && pc->pointcloud)
 	{
-		tf2::Transform tx;
-		tf2::fromMsg(sensorOnRobot.transform, tx);
-		return mrpt::ros2bridge::fromROS(tx);
-	}();
+		pc->pointcloud =
+			std::dynamic_pointer_cast<CPointsMap>(pc->pointcloud->duplicateGetSmartPtr());
+	}
 
-	// In MRPT, CObservation2DRangeScan holds both: sensor data +
-	// relative pose:
-	auto obsScan = CObservation2DRangeScan::Create();
-	mrpt::ros2bridge::fromROS(*scan, sensorOnRobot_mrpt, *obsScan);
+	auto& pl = ps.per_obs.front();
+	mp2p_icp::metric_map_t mm;
+	mp2p_icp_filters::apply_generators(pl.generator, *obs, mm);
+	mp2p_icp_filters::apply_filter_pipeline(pl.pipeline, mm);
 
-	RCLCPP_DEBUG(
-		get_logger(), "[onNewSensor_Laser2D] %u rays, sensor pose on robot %s",
-		static_cast<unsigned int>(obsScan->getScanSize()), sensorOnRobot_mrpt.asString().c_str());
+	// The final pipeline also gets the obstacle memory layer, as in
+	// on_do_publish(). Its contents are irrelevant here:
+	if (!m_memory_source_layer.empty())
+		mm.layers[m_memory_output_layer] = mrpt::maps::CSimplePointsMap::Create();
 
-	// Get sensor timestamp:
-	auto stamp = scan->header.stamp;
-	const double timestamp = stamp.sec + static_cast<double>(stamp.nanosec) / 1e9;
+	mp2p_icp_filters::apply_filter_pipeline(ps.final, mm);
 
-	// Get robot pose at that time in the reference frame, typ: /odom ->
-	// /base_link
-	mrpt::poses::CPose3D robotPose;
-	try
+	// All layers to be published must exist, and be point clouds:
+	const auto checkLayer = [&mm](const std::string& layer)
+	{
+		ASSERTMSG_(
+			mm.layers.count(layer) != 0 && mm.point_layer(layer),
+			mrpt::format("The pipeline does not generate the point layer '%s'", layer.c_str()));
+	};
+	for (const auto& e : layer2topic_) checkLayer(e.layer);
+	if (m_pub_grid) checkLayer(m_grid_layer);
+}
+
+void LocalObstaclesNode::request_pipeline_reload()
+{
+	auto lck = mrpt::lockHelper(m_pipeline_reload_mtx);
+	m_pipeline_reload_requested = true;
+	if (m_pipeline_reload_running) return;	// The running task will handle it
+
+	m_pipeline_reload_running = true;
+	m_pipeline_reload_task = std::async(std::launch::async, [this]() { pipeline_reload_task(); });
+}
+
+void LocalObstaclesNode::pipeline_reload_task()
+{
+	for (;;)
 	{
-		CTimeLoggerEntry tle3(m_profiler, "onNewSensor_Laser2D.lookupTransform_robot");
+		std::string yamlFile;
+		{
+			auto lck = mrpt::lockHelper(m_pipeline_reload_mtx);
+			if (!m_pipeline_reload_requested)
+			{
+				m_pipeline_reload_running = false;
+				return;
+			}
+			m_pipeline_reload_requested = false;
+			yamlFile = m_pipeline_yaml_file;
+		}
 
-		geometry_msgs::msg::TransformStamped robotTfStamp;
+		RCLCPP_INFO(get_logger(), "Reloading pipeline_yaml_file: %s", yamlFile.c_str());
 		try
 		{
-			robotTfStamp = m_tf_buffer->lookupTransform(
-				m_frameid_reference, m_frameid_robot, tf2::TimePointZero);
+			auto ps = load_pipelines(yamlFile, m_num_pipeline_instances);
+			validate_pipelines(ps);
+
+			auto lck = mrpt::lockHelper(m_pipeline_reload_mtx);
+			m_pending_pipelines = std::move(ps);
 		}
-		catch (const tf2::ExtrapolationException& ex)
+		catch (const std::exception& e)
 		{
-			RCLCPP_ERROR(get_logger(), "%s", ex.what());
-			return;
+			RCLCPP_ERROR(
+				get_logger(), "Error reloading '%s', keeping the former pipeline:\n%s",
+				yamlFile.c_str(), mrpt::exception_to_str(e).c_str());
 		}
+	}
+}
 
-		robotPose = [&]()
-		{
-			tf2::Transform tx;
-			tf2::fromMsg(robotTfStamp.transform, tx);
-			return mrpt::ros2bridge::fromROS(tx);
-		}();
+bool LocalObstaclesNode::apply_pending_pipelines()
+{
+	std::optional<PipelineSet> ps;
+	{
+		auto lck = mrpt::lockHelper(m_pipeline_reload_mtx);
+		if (!m_pending_pipelines) return false;
+		ps = std::move(m_pending_pipelines);
+		m_pending_pipelines.reset();
+	}
+	ASSERT_EQUAL_(ps->per_obs.size(), m_per_obs_pipelines.size());
 
-		RCLCPP_DEBUG(
-			get_logger(), "[onNewSensor_Laser2D] robot pose %s", robotPose.asString().c_str());
+	// Wait for all instances to be released by sensor threads, and keep the
+	// lock so none is taken until they are replaced:
+	std::unique_lock<std::mutex> lck(m_free_per_obs_pipelines_mtx);
+	m_free_per_obs_pipelines_cv.wait(
+		lck,
+		[this]() { return m_free_per_obs_pipelines.size() == m_per_obs_pipelines.size(); });
+
+	m_per_obs_pipelines = std::move(ps->per_obs);
+	m_final_pipeline = std::move(ps->final);
+	// Invalidates all observations processed with the former pipeline:
+	m_pipeline_version++;
+
+	RCLCPP_INFO(
+		get_logger(), "New pipeline in use (version %u).",
+		static_cast<unsigned int>(m_pipeline_version));
+	return true;
+}
+
+void LocalObstaclesNode::check_pipeline_file_modified()
+{
+	{
+		auto lck = mrpt::lockHelper(m_pipeline_reload_mtx);
+		// It may not exist for a moment while being saved:
+		if (!mrpt::system::fileExists(m_pipeline_yaml_file)) return;
+
+		const time_t t = mrpt::system::getFileModificationTime(m_pipeline_yaml_file);
+		if (t == m_pipeline_file_mtime) return;
+		m_pipeline_file_mtime = t;
 	}
-	catch (const tf2::TransformException& ex)
+	request_pipeline_reload();
+}
+
+void LocalObstaclesNode::on_new_observation(InfoPerTimeStep&& ipt)
+{
+	// Stage 1: per-observation processing, right now in this sensor thread:
+	if (m_process_on_arrival)
 	{
-		RCLCPP_ERROR(get_logger(), "%s", ex.what());
-		return;
+		CTimeLoggerEntry tle(m_profiler, "on_new_observation.apply_per_obs_pipeline");
+		get_processed_observation(ipt);
 	}
 
+	const double stamp = ipt.timestamp;
+	const std::string topic = ipt.sourceTopic;
+
+	m_hist_obs.push(std::move(ipt));
+
+	// Stage 2: merge and publish, if enough new scans arrived or all sensors
+	// are fresh. Otherwise, wait for the next publish timer tick.
+	if (m_publish_triggers.on_new_observation(topic, stamp, m_hist_obs.head()) !=
+		mrpt_pointcloud_pipeline::PublishTriggers::Trigger::None)
+		on_do_publish();
+}
+
+void LocalObstaclesNode::on_new_sensor_laser_2d(
+	const sensor_msgs::msg::LaserScan::SharedPtr& scan, const std::string& topicName)
+{
+	CTimeLoggerEntry tle(m_profiler, "on_new_sensor_laser_2d");
+
+	const auto sensorOnRobot = get_sensor_pose(scan->header.frame_id);
+	if (!sensorOnRobot) return;
+
+	// Get sensor timestamp:
+	const double timestamp = mrpt::Clock::toDouble(mrpt::ros2bridge::fromROS(scan->header.stamp));
+
+	// Get robot pose at that time in the reference frame, typ: /odom ->
+	// /base_link
+	const auto robotPose = get_robot_pose(timestamp);
+	if (!robotPose) return;
+
+	// In MRPT, CObservation2DRangeScan holds both: sensor data +
+	// relative pose:
+	auto obsScan = CObservation2DRangeScan::Create();
+	mrpt::ros2bridge::fromROS(*scan, *sensorOnRobot, *obsScan);
+
+	RCLCPP_DEBUG(
+		get_logger(), "[onNewSensor_Laser2D] %u rays, sensor pose on robot %s, robot pose %s",
+		static_cast<unsigned int>(obsScan->getScanSize()), sensorOnRobot->asString().c_str(),
+		robotPose->asString().c_str());
+
 	// Insert into the observation history:
 	InfoPerTimeStep ipt;
 	ipt.sourceTopic = topicName;
+	ipt.timestamp = timestamp;
 	ipt.observation = obsScan;
-	ipt.robot_pose = robotPose;
+	ipt.robot_pose = *robotPose;
 
-	m_hist_obs_mtx.lock();
-	m_hist_obs.insert(m_hist_obs.end(), obs_list_t::value_type(timestamp, ipt));
-	m_hist_obs_mtx.unlock();
+	on_new_observation(std::move(ipt));
 
 }  // end on_new_sensor_laser_2d
 
@@ -400,89 +707,138 @@ void LocalObstaclesNode::on_new_sensor_pointcloud(
 	CTimeLoggerEntry tle(m_profiler, "on_new_sensor_pointcloud");
 
 	// Get the relative position of the sensor wrt the robot:
-	geometry_msgs::msg::TransformStamped sensorOnRobot;
-	try
-	{
-		CTimeLoggerEntry tle2(m_profiler, "on_new_sensor_pointcloud.lookupTransform_sensor");
+	const auto sensorOnRobot = get_sensor_pose(pts->header.frame_id);
+	if (!sensorOnRobot) return;
 
-		sensorOnRobot =
-			m_tf_buffer->lookupTransform(m_frameid_robot, pts->header.frame_id, tf2::TimePointZero);
-	}
-	catch (const tf2::TransformException& ex)
-	{
-		RCLCPP_ERROR(get_logger(), "%s", ex.what());
-		return;
-	}
+	// Get sensor timestamp:
+	const double timestamp = mrpt::Clock::toDouble(mrpt::ros2bridge::fromROS(pts->header.stamp));
 
-	// Convert data to MRPT format:
-	const mrpt::poses::CPose3D sensorOnRobot_mrpt = [&]()
-	{
-		tf2::Transform tx;
-		tf2::fromMsg(sensorOnRobot.transform, tx);
-		return mrpt::ros2bridge::fromROS(tx);
-	}();
+	// Get robot pose at that time in the reference frame, typ: /odom ->
+	// /base_link
+	const auto robotPose = get_robot_pose(timestamp);
+	if (!robotPose) return;
 
 	// In MRPT, CObservationPointCloud holds both: sensor data +
 	// relative pose:
 	auto obsPts = CObservationPointCloud::Create();
-	const auto ptsMap = mrpt::maps::CSimplePointsMap::Create();
+	obsPts->sensorPose = *sensorOnRobot;
+
+	mrpt::maps::CPointsMap::Ptr ptsMap;
+#if MRPT_VERSION >= 0x020b04
+	// Read the per-point ring and time fields, only if needed for ring-based
+	// filters (e.g. FilterGroundSegmentation) or for deskewing:
+	if (const auto fields = mrpt::ros2bridge::extractFields(*pts);
+		mrpt_pointcloud_pipeline::needs_point_fields(
+			m_point_cloud_options, fields.count("ring") != 0, fields.count("time") != 0))
+	{
+		auto ptsIRT = mrpt::maps::CPointsMapXYZIRT::Create();
+		if (mrpt::ros2bridge::fromROS(*pts, *ptsIRT)) ptsMap = ptsIRT;
+	}
+#endif
+	if (ptsMap)
+	{
+		CTimeLoggerEntry tle2(m_profiler, "on_new_sensor_pointcloud.prepare_point_cloud");
+		ptsMap = mrpt_pointcloud_pipeline::prepare_point_cloud(
+			ptsMap, m_point_cloud_options, *sensorOnRobot, *robotPose, timestamp, m_robot_poses);
+	}
+	else
+	{
+		auto simplePts = mrpt::maps::CSimplePointsMap::Create();
+		mrpt::ros2bridge::fromROS(*pts, *simplePts);
+		ptsMap = simplePts;
+	}
 	obsPts->pointcloud = ptsMap;
-	obsPts->sensorPose = sensorOnRobot_mrpt;
-	mrpt::ros2bridge::fromROS(*pts, *ptsMap);
 
 	RCLCPP_DEBUG(
-		get_logger(), "[on_new_sensor_pointcloud] %u points, sensor pose on robot %s",
-		static_cast<unsigned int>(ptsMap->size()), sensorOnRobot_mrpt.asString().c_str());
+		get_logger(), "[on_new_sensor_pointcloud] %u points, sensor pose %s, robot pose %s",
+		static_cast<unsigned int>(ptsMap->size()), sensorOnRobot->asString().c_str(),
+		robotPose->asString().c_str());
 
-	// Get sensor timestamp:
-	auto stamp = pts->header.stamp;
-	const double timestamp = stamp.sec + static_cast<double>(stamp.nanosec) / 1e9;
+	// Insert into the observation history:
+	InfoPerTimeStep ipt;
+	ipt.sourceTopic = topicName;
+	ipt.timestamp = timestamp;
+	ipt.observation = obsPts;
+	ipt.robot_pose = *robotPose;
 
-	// Get robot pose at that time in the reference frame, typ: /odom ->
-	// /base_link
-	mrpt::poses::CPose3D robotPose;
+	on_new_observation(std::move(ipt));
+}  // end on_new_sensor_pointcloud
+
+void LocalObstaclesNode::on_odometry(const nav_msgs::msg::Odometry::SharedPtr& odo)
+{
+	m_robot_poses.add(
+		mrpt::Clock::toDouble(mrpt::ros2bridge::fromROS(odo->header.stamp)),
+		mrpt::ros2bridge::fromROS(odo->pose.pose));
+}
+
+void LocalObstaclesNode::sample_robot_pose_from_tf()
+{
+	CTimeLoggerEntry tle(m_profiler, "sample_robot_pose_from_tf");
+
+	geometry_msgs::msg::TransformStamped tx;
 	try
 	{
-		CTimeLoggerEntry tle3(m_profiler, "onNewSensor_pointcloud.lookupTransform_robot");
+		tx = m_tf_buffer->lookupTransform(m_frameid_reference, m_frameid_robot, tf2::TimePointZero);
+	}
+	catch (const tf2::TransformException& ex)
+	{
+		RCLCPP_WARN_THROTTLE(get_logger(), *get_clock(), 5000, "%s", ex.what());
+		return;
+	}
 
-		geometry_msgs::msg::TransformStamped robotTfStamp;
-		try
-		{
-			robotTfStamp = m_tf_buffer->lookupTransform(
-				m_frameid_reference, m_frameid_robot, tf2::TimePointZero);
-		}
-		catch (const tf2::ExtrapolationException& ex)
-		{
-			RCLCPP_ERROR(get_logger(), "%s", ex.what());
-			return;
-		}
+	tf2::Transform tfx;
+	tf2::fromMsg(tx.transform, tfx);
+	m_robot_poses.add(
+		mrpt::Clock::toDouble(mrpt::ros2bridge::fromROS(tx.header.stamp)),
+		mrpt::ros2bridge::fromROS(tfx));
+}
 
-		robotPose = [&]()
-		{
-			tf2::Transform tx;
-			tf2::fromMsg(robotTfStamp.transform, tx);
-			return mrpt::ros2bridge::fromROS(tx);
-		}();
+std::optional<mrpt::poses::CPose3D> LocalObstaclesNode::get_sensor_pose(
+	const std::string& sensorFrameId)
+{
+	auto lck = mrpt::lockHelper(m_sensor_poses_mtx);
 
-		RCLCPP_DEBUG(
-			get_logger(), "[onNewSensor_pointcloud] robot pose %s", robotPose.asString().c_str());
+	if (auto it = m_sensor_poses.find(sensorFrameId); it != m_sensor_poses.end())
+		return it->second;
+
+	CTimeLoggerEntry tle(m_profiler, "get_sensor_pose.lookupTransform");
+
+	geometry_msgs::msg::TransformStamped sensorOnRobot;
+	try
+	{
+		sensorOnRobot =
+			m_tf_buffer->lookupTransform(m_frameid_robot, sensorFrameId, tf2::TimePointZero);
 	}
 	catch (const tf2::TransformException& ex)
 	{
 		RCLCPP_ERROR(get_logger(), "%s", ex.what());
-		return;
+		return {};
 	}
 
-	// Insert into the observation history:
-	InfoPerTimeStep ipt;
-	ipt.sourceTopic = topicName;
-	ipt.observation = obsPts;
-	ipt.robot_pose = robotPose;
+	tf2::Transform tx;
+	tf2::fromMsg(sensorOnRobot.transform, tx);
+	const auto p = mrpt::ros2bridge::fromROS(tx);
+	m_sensor_poses[sensorFrameId] = p;
 
-	m_hist_obs_mtx.lock();
-	m_hist_obs.insert(m_hist_obs.end(), obs_list_t::value_type(timestamp, ipt));
-	m_hist_obs_mtx.unlock();
-}  // end on_new_sensor_pointcloud
+	RCLCPP_INFO(
+		get_logger(), "Cached pose of sensor frame '%s': %s", sensorFrameId.c_str(),
+		p.asString().c_str());
+
+	return p;
+}
+
+std::optional<mrpt::poses::CPose3D> LocalObstaclesNode::get_robot_pose(double timestamp)
+{
+	auto p = m_robot_poses.interpolate(timestamp);
+	if (!p)
+	{
+		RCLCPP_WARN_THROTTLE(
+			get_logger(), *get_clock(), 2000,
+			"No robot pose ('%s'->'%s') available for timestamp %f.",
+			m_frameid_reference.c_str(), m_frameid_robot.c_str(), timestamp);
+	}
+	return p;
+}
 
 // read params from parameter server
 void LocalObstaclesNode::read_parameters()
@@ -503,12 +859,68 @@ void LocalObstaclesNode::read_parameters()
 	this->get_parameter("time_window", m_time_window);
 	RCLCPP_INFO(get_logger(), "time_window: %f", m_time_window);
 
+	this->declare_parameter<std::string>("topic_odometry", m_topic_odometry);
+	this->get_parameter("topic_odometry", m_topic_odometry);
+	RCLCPP_INFO(get_logger(), "topic_odometry: %s", m_topic_odometry.c_str());
+
+	this->declare_parameter<double>("tf_sample_period", m_tf_sample_period);
+	this->get_parameter("tf_sample_period", m_tf_sample_period);
+	RCLCPP_INFO(get_logger(), "tf_sample_period: %f", m_tf_sample_period);
+	ASSERT_GT_(m_tf_sample_period, 0);
+
+	auto& pco = m_point_cloud_options;
+
+	this->declare_parameter<bool>("deskew_enable", pco.deskew_enable);
+	this->get_parameter("deskew_enable", pco.deskew_enable);
+	RCLCPP_INFO(get_logger(), "deskew_enable: %s", pco.deskew_enable ? "true" : "false");
+
+	int deskew_time_bins = static_cast<int>(pco.deskew_time_bins);
+	this->declare_parameter<int>("deskew_time_bins", deskew_time_bins);
+	this->get_parameter("deskew_time_bins", deskew_time_bins);
+	RCLCPP_INFO(get_logger(), "deskew_time_bins: %i", deskew_time_bins);
+	ASSERT_GT_(deskew_time_bins, 0);
+	pco.deskew_time_bins = static_cast<size_t>(deskew_time_bins);
+
+	this->declare_parameter<bool>("keep_ring_field", pco.keep_ring_field);
+	this->get_parameter("keep_ring_field", pco.keep_ring_field);
+	RCLCPP_INFO(get_logger(), "keep_ring_field: %s", pco.keep_ring_field ? "true" : "false");
+
+#if MRPT_VERSION < 0x020b04
+	// Point clouds are always converted into plain (x,y,z) maps:
+	if (pco.deskew_enable || pco.keep_ring_field)
+	{
+		RCLCPP_WARN(
+			get_logger(),
+			"deskew_enable and keep_ring_field require MRPT>=2.11.4 (per-point "
+			"fields), and are ignored with this MRPT version.");
+		pco.deskew_enable = false;
+		pco.keep_ring_field = false;
+	}
+#endif
+
+	this->declare_parameter<double>("pose_buffer_length", m_robot_poses.max_length);
+	this->get_parameter("pose_buffer_length", m_robot_poses.max_length);
+	RCLCPP_INFO(get_logger(), "pose_buffer_length: %f", m_robot_poses.max_length);
+	// The pose buffer must cover the whole time window:
+	ASSERT_GE_(m_robot_poses.max_length, m_time_window);
+
+	this->declare_parameter<double>("pose_max_extrapolation", m_robot_poses.max_extrapolation);
+	this->get_parameter("pose_max_extrapolation", m_robot_poses.max_extrapolation);
+	RCLCPP_INFO(get_logger(), "pose_max_extrapolation: %f", m_robot_poses.max_extrapolation);
+
 	this->declare_parameter<bool>("one_observation_per_topic", m_one_observation_per_topic);
 	this->get_parameter("one_observation_per_topic", m_one_observation_per_topic);
 	RCLCPP_INFO(
 		get_logger(), "one_observation_per_topic: %s",
 		m_one_observation_per_topic ? "true" : "false");
 
+	int history_capacity = static_cast<int>(m_hist_obs.capacity());
+	this->declare_parameter<int>("history_capacity", history_capacity);
+	this->get_parameter("history_capacity", history_capacity);
+	RCLCPP_INFO(get_logger(), "history_capacity: %i", history_capacity);
+	ASSERT_GT_(history_capacity, 0);
+	m_hist_obs.reset(static_cast<size_t>(history_capacity));
+
 	this->declare_parameter<double>("publish_period", 0.05);
 	this->get_parameter("publish_period", m_publish_period);
 	RCLCPP_INFO(get_logger(), "publish_period: %f", m_publish_period);
@@ -516,6 +928,23 @@ void LocalObstaclesNode::read_parameters()
 	// publish_period can't be larger than m_time_window:
 	ASSERT_LE_(m_publish_period, m_time_window);
 
+	this->declare_parameter<bool>("process_on_arrival", m_process_on_arrival);
+	this->get_parameter("process_on_arrival", m_process_on_arrival);
+	RCLCPP_INFO(get_logger(), "process_on_arrival: %s", m_process_on_arrival ? "true" : "false");
+
+	auto& pt = m_publish_triggers;
+
+	this->declare_parameter<bool>("publish_on_all_sensors_fresh", pt.publish_on_all_sensors_fresh);
+	this->get_parameter("publish_on_all_sensors_fresh", pt.publish_on_all_sensors_fresh);
+	RCLCPP_INFO(
+		get_logger(), "publish_on_all_sensors_fresh: %s",
+		pt.publish_on_all_sensors_fresh ? "true" : "false");
+
+	this->declare_parameter<int>("publish_every_n_scans", pt.publish_every_n_scans);
+	this->get_parameter("publish_every_n_scans", pt.publish_every_n_scans);
+	RCLCPP_INFO(get_logger(), "publish_every_n_scans: %i", pt.publish_every_n_scans);
+	ASSERT_GE_(pt.publish_every_n_scans, 0);
+
 	this->declare_parameter<std::string>("source_topics_2d_scans", "scan, laser1");
 	this->get_parameter("source_topics_2d_scans", m_topics_source_2dscan);
 	RCLCPP_INFO(get_logger(), "source_topics_2d_scans: %s", m_topics_source_2dscan.c_str());
@@ -524,24 +953,44 @@ void LocalObstaclesNode::read_parameters()
 	this->get_parameter("source_topics_pointclouds", m_topics_source_pointclouds);
 	RCLCPP_INFO(get_logger(), "source_topics_pointclouds: %s", m_topics_source_pointclouds.c_str());
 
+	this->declare_parameter<int>("num_worker_threads", m_num_worker_threads);
+	this->get_parameter("num_worker_threads", m_num_worker_threads);
+	ASSERT_GE_(m_num_worker_threads, 0);
+	const size_t nThreads = m_num_worker_threads > 0
+								? static_cast<size_t>(m_num_worker_threads)
+								: std::max<size_t>(1, std::thread::hardware_concurrency());
+	RCLCPP_INFO(
+		get_logger(), "num_worker_threads: %i (using %u)", m_num_worker_threads,
+		static_cast<unsigned int>(nThreads));
+
+	if (nThreads > 1)
+	{
+		m_workers = std::make_unique<mrpt::WorkerThreadsPool>(
+			nThreads, mrpt::WorkerThreadsPool::POLICY_FIFO, "pc_pipeline");
+	}
+
 	this->declare_parameter<std::string>("pipeline_yaml_file", m_pipeline_yaml_file);
 	this->get_parameter("pipeline_yaml_file", m_pipeline_yaml_file);
 	RCLCPP_INFO(get_logger(), "pipeline_yaml_file: %s", m_pipeline_yaml_file.c_str());
 	{
-		ASSERT_FILE_EXISTS_(m_pipeline_yaml_file);
-		const mrpt::containers::yaml cfg = mrpt::containers::yaml::FromFile(m_pipeline_yaml_file);
-
-		RCLCPP_DEBUG_STREAM(get_logger(), cfg);
+		// One independent instance per worker:
+		m_num_pipeline_instances = nThreads;
+		auto ps = load_pipelines(m_pipeline_yaml_file, nThreads);
+		m_per_obs_pipelines = std::move(ps.per_obs);
+		m_final_pipeline = std::move(ps.final);
 
-		ASSERT_(cfg.has("generators"));
-		ASSERT_(cfg.has("per_observation"));
-		ASSERT_(cfg.has("final"));
+		m_free_per_obs_pipelines.clear();
+		for (size_t i = 0; i < nThreads; i++) m_free_per_obs_pipelines.push_back(i);
 
-		m_generator = mp2p_icp_filters::generators_from_yaml(cfg["generators"]);
-		m_per_obs_pipeline = mp2p_icp_filters::filter_pipeline_from_yaml(cfg["per_observation"]);
-		m_final_pipeline = mp2p_icp_filters::filter_pipeline_from_yaml(cfg["final"]);
+		m_pipeline_file_mtime = mrpt::system::getFileModificationTime(m_pipeline_yaml_file);
 	}
 
+	// The pipeline file is reloaded if modified, or if the parameter changes:
+	this->declare_parameter<double>("pipeline_watch_period", m_pipeline_watch_period);
+	this->get_parameter("pipeline_watch_period", m_pipeline_watch_period);
+	RCLCPP_INFO(get_logger(), "pipeline_watch_period: %f", m_pipeline_watch_period);
+	ASSERT_GE_(m_pipeline_watch_period, 0);
+
 	// Output layer(s) ==> ROS topic(s) mapping:
 	// --------------------------------------------------
 	std::string filter_output_layer_name = "output";
@@ -566,8 +1015,79 @@ void LocalObstaclesNode::read_parameters()
 		e.layer = lstLayers.at(i);
 		e.topic = lstTopics.at(i);
 
-		// Create publisher for local map point cloud:
-		e.pub = this->create_publisher<sensor_msgs::msg::PointCloud2>(e.topic, 10);
+		// Create publisher for local map point cloud, handing clouds over
+		// with no copies to intra-process subscribers (e.g. the PF node):
+		rclcpp::PublisherOptions pubOpts;
+		pubOpts.use_intra_process_comm = rclcpp::IntraProcessSetting::Enable;
+		e.pub = this->create_publisher<sensor_msgs::msg::PointCloud2>(e.topic, 10, pubOpts);
+	}
+
+	// Optional obstacle memory:
+	// --------------------------------------------------
+	this->declare_parameter<std::string>("memory_source_layer", m_memory_source_layer);
+	this->get_parameter("memory_source_layer", m_memory_source_layer);
+	RCLCPP_INFO(get_logger(), "memory_source_layer: %s", m_memory_source_layer.c_str());
+
+	if (!m_memory_source_layer.empty())
+	{
+		auto& mp = m_memory.params;
+
+		this->declare_parameter<std::string>("memory_output_layer", m_memory_output_layer);
+		this->get_parameter("memory_output_layer", m_memory_output_layer);
+		RCLCPP_INFO(get_logger(), "memory_output_layer: %s", m_memory_output_layer.c_str());
+
+		this->declare_parameter<double>("memory_voxel_size", mp.voxel_size);
+		this->get_parameter("memory_voxel_size", mp.voxel_size);
+		RCLCPP_INFO(get_logger(), "memory_voxel_size: %f", mp.voxel_size);
+		ASSERT_GT_(mp.voxel_size, 0);
+
+		this->declare_parameter<double>("memory_ttl", mp.ttl);
+		this->get_parameter("memory_ttl", mp.ttl);
+		RCLCPP_INFO(get_logger(), "memory_ttl: %f", mp.ttl);
+
+		int min_hits = static_cast<int>(mp.min_hits);
+		this->declare_parameter<int>("memory_min_hits", min_hits);
+		this->get_parameter("memory_min_hits", min_hits);
+		RCLCPP_INFO(get_logger(), "memory_min_hits: %i", min_hits);
+		ASSERT_GE_(min_hits, 0);
+		mp.min_hits = static_cast<uint32_t>(min_hits);
+
+		this->declare_parameter<bool>("memory_ray_clearing", mp.ray_clearing);
+		this->get_parameter("memory_ray_clearing", mp.ray_clearing);
+		RCLCPP_INFO(get_logger(), "memory_ray_clearing: %s", mp.ray_clearing ? "true" : "false");
+
+		this->declare_parameter<double>("memory_max_ray_length", mp.max_ray_length);
+		this->get_parameter("memory_max_ray_length", mp.max_ray_length);
+		RCLCPP_INFO(get_logger(), "memory_max_ray_length: %f", mp.max_ray_length);
+	}
+
+	// Optional robot-centered obstacle grid:
+	// --------------------------------------------------
+	std::string topic_local_map_grid;
+	this->declare_parameter<std::string>("topic_local_map_grid", topic_local_map_grid);
+	this->get_parameter("topic_local_map_grid", topic_local_map_grid);
+	RCLCPP_INFO(get_logger(), "topic_local_map_grid: %s", topic_local_map_grid.c_str());
+
+	if (!topic_local_map_grid.empty())
+	{
+		m_grid_layer = lstLayers.empty() ? std::string() : lstLayers.front();
+		this->declare_parameter<std::string>("grid_layer", m_grid_layer);
+		this->get_parameter("grid_layer", m_grid_layer);
+		RCLCPP_INFO(get_logger(), "grid_layer: %s", m_grid_layer.c_str());
+		ASSERT_(!m_grid_layer.empty());
+
+		double grid_resolution = 0.05, grid_size = 6.0;
+		this->declare_parameter<double>("grid_resolution", grid_resolution);
+		this->get_parameter("grid_resolution", grid_resolution);
+		RCLCPP_INFO(get_logger(), "grid_resolution: %f", grid_resolution);
+
+		this->declare_parameter<double>("grid_size", grid_size);
+		this->get_parameter("grid_size", grid_size);
+		RCLCPP_INFO(get_logger(), "grid_size: %f", grid_size);
+
+		m_obstacle_grid.resize(grid_resolution, grid_size);
+
+		m_pub_grid = this->create_publisher<nav_msgs::msg::OccupancyGrid>(topic_local_map_grid, 10);
 	}
 }
 
@@ -0,0 +1,493 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+// ===========================================================================
+//  Program: mrpt_pointcloud_pipeline_benchmark
+//  Intention: Replay a rawlog through a point-cloud pipeline YAML file, with
+//             the same stages, time-window semantics and publish triggers as
+//             LocalObstaclesNode (sharing its code in local_map_builder.h),
+//             and report timing and point counts as JSON. Sensor and robot
+//             poses are taken from the rawlog observations and odometry
+//             instead of /tf. Not replicated: ROS message conversions and
+//             publishing, the obstacle grid, pipeline hot-reloading, and the
+//             parallel per-observation workers (all stages run sequentially
+//             here).
+// ===========================================================================
+
+#include <mp2p_icp/metricmap.h>
+#include <mp2p_icp_filters/FilterBase.h>
+#include <mp2p_icp_filters/Generator.h>
+#include <mrpt/3rdparty/tclap/CmdLine.h>
+#include <mrpt/containers/yaml.h>
+#include <mrpt/core/format.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/obs/CObservation2DRangeScan.h>
+#include <mrpt/obs/CObservationOdometry.h>
+#include <mrpt/obs/CObservationPointCloud.h>
+#include <mrpt/obs/CRawlog.h>
+#include <mrpt/obs/CSensoryFrame.h>
+#include <mrpt/system/CTicTac.h>
+#include <mrpt/system/filesystem.h>
+#include <mrpt/version.h>
+#include <mrpt_pointcloud_pipeline/decaying_voxel_map.h>
+#include <mrpt_pointcloud_pipeline/local_map_builder.h>
+#include <mrpt_pointcloud_pipeline/pose_buffer.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <set>
+
+// Declare the supported command line switches ===========
+TCLAP::CmdLine cmd("mrpt_pointcloud_pipeline_benchmark", ' ', MRPT_getVersion().c_str());
+
+TCLAP::UnlabeledValueArg<std::string> arg_rawlog(
+	"rawlog", "Input dataset (*.rawlog)", true, "dataset.rawlog", "Files", cmd);
+
+TCLAP::ValueArg<std::string> arg_pipeline(
+	"p", "pipeline", "Pipeline definition file, as for the node 'pipeline_yaml_file' (*.yaml)",
+	true, "", "point-cloud-pipeline.yaml", cmd);
+
+TCLAP::ValueArg<double> arg_time_window(
+	"", "time-window", "Same as the node 'time_window' param [s]", false, 0.20, "0.20", cmd);
+
+TCLAP::ValueArg<double> arg_publish_period(
+	"", "publish-period", "Same as the node 'publish_period' param [s]", false, 0.05, "0.05", cmd);
+
+TCLAP::SwitchArg arg_one_obs_per_topic(
+	"", "one-observation-per-topic", "Same as the node 'one_observation_per_topic' param", cmd,
+	false);
+
+TCLAP::SwitchArg arg_all_sensors_fresh(
+	"", "publish-on-all-sensors-fresh", "Same as the node 'publish_on_all_sensors_fresh' param",
+	cmd, false);
+
+TCLAP::ValueArg<int> arg_publish_every_n_scans(
+	"", "publish-every-n-scans", "Same as the node 'publish_every_n_scans' param", false, 0, "0",
+	cmd);
+
+TCLAP::SwitchArg arg_deskew(
+	"", "deskew", "Same as the node 'deskew_enable' param (requires odometry)", cmd, false);
+
+TCLAP::ValueArg<int> arg_deskew_time_bins(
+	"", "deskew-time-bins", "Same as the node 'deskew_time_bins' param", false, 64, "64", cmd);
+
+TCLAP::SwitchArg arg_keep_ring_field(
+	"", "keep-ring-field", "Same as the node 'keep_ring_field' param", cmd, false);
+
+TCLAP::ValueArg<std::string> arg_memory_source_layer(
+	"", "memory-source-layer", "Same as the node 'memory_source_layer' param (Default: disabled)",
+	false, "", "obstacles", cmd);
+
+TCLAP::ValueArg<std::string> arg_memory_output_layer(
+	"", "memory-output-layer", "Same as the node 'memory_output_layer' param", false, "memory",
+	"memory", cmd);
+
+TCLAP::ValueArg<double> arg_memory_voxel_size(
+	"", "memory-voxel-size", "Same as the node 'memory_voxel_size' param [m]", false, 0.10,
+	"0.10", cmd);
+
+TCLAP::ValueArg<double> arg_memory_ttl(
+	"", "memory-ttl", "Same as the node 'memory_ttl' param [s]", false, 5.0, "5.0", cmd);
+
+TCLAP::ValueArg<int> arg_memory_min_hits(
+	"", "memory-min-hits", "Same as the node 'memory_min_hits' param", false, 1, "1", cmd);
+
+TCLAP::SwitchArg arg_memory_no_ray_clearing(
+	"", "memory-no-ray-clearing", "Same as setting the node 'memory_ray_clearing' param to false",
+	cmd, false);
+
+TCLAP::ValueArg<double> arg_memory_max_ray_length(
+	"", "memory-max-ray-length", "Same as the node 'memory_max_ray_length' param [m]", false,
+	10.0, "10.0", cmd);
+
+TCLAP::ValueArg<std::string> arg_output(
+	"o", "output", "Output JSON file (Default: stdout)", false, "", "results.json", cmd);
+
+namespace
+{
+struct StageStats
+{
+	size_t calls = 0;
+	double time = 0;  //!< [s]
+	size_t input_points = 0, output_points = 0;
+
+	void add(double t, size_t in, size_t out)
+	{
+		calls++;
+		time += t;
+		input_points += in;
+		output_points += out;
+	}
+};
+
+size_t count_points(const mp2p_icp::metric_map_t& m)
+{
+	size_t n = 0;
+	for (const auto& [name, layer] : m.layers)
+	{
+		(void)name;
+		if (const auto* pts = mp2p_icp::MapToPointsMap(*layer); pts) n += pts->size();
+	}
+	return n;
+}
+
+size_t count_points(const mrpt::obs::CObservation& o)
+{
+	if (const auto* s = dynamic_cast<const mrpt::obs::CObservation2DRangeScan*>(&o); s)
+		return s->getScanSize();
+	if (const auto* p = dynamic_cast<const mrpt::obs::CObservationPointCloud*>(&o);
+		p && p->pointcloud)
+		return p->pointcloud->size();
+	return 0;
+}
+
+// Quoted JSON string, with all special characters escaped:
+std::string json_str(const std::string& s)
+{
+	std::string r = "\"";
+	for (const char c : s)
+	{
+		switch (c)
+		{
+			case '"':
+				r += "\\\"";
+				break;
+			case '\\':
+				r += "\\\\";
+				break;
+			case '\n':
+				r += "\\n";
+				break;
+			case '\r':
+				r += "\\r";
+				break;
+			case '\t':
+				r += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					r += mrpt::format("\\u%04x", static_cast<unsigned int>(c));
+				else
+					r += c;
+		}
+	}
+	return r + "\"";
+}
+
+const char* json_bool(bool b) { return b ? "true" : "false"; }
+
+void write_json(
+	std::ostream& o, size_t nObs, const std::map<std::string, size_t>& localMapsPerTrigger,
+	const std::vector<std::pair<std::string, StageStats>>& stages)
+{
+	size_t nLocalMaps = 0;
+	for (const auto& [trigger, n] : localMapsPerTrigger) nLocalMaps += n;
+
+	o << "{\n";
+	o << "  \"rawlog\": " << json_str(arg_rawlog.getValue()) << ",\n";
+	o << "  \"pipeline\": " << json_str(arg_pipeline.getValue()) << ",\n";
+	o << "  \"time_window\": " << arg_time_window.getValue() << ",\n";
+	o << "  \"publish_period\": " << arg_publish_period.getValue() << ",\n";
+	o << "  \"one_observation_per_topic\": " << json_bool(arg_one_obs_per_topic.getValue())
+	  << ",\n";
+	o << "  \"publish_on_all_sensors_fresh\": "
+	  << json_bool(arg_all_sensors_fresh.getValue()) << ",\n";
+	o << "  \"publish_every_n_scans\": " << arg_publish_every_n_scans.getValue() << ",\n";
+	o << "  \"deskew_enable\": " << json_bool(arg_deskew.getValue()) << ",\n";
+	o << "  \"keep_ring_field\": " << json_bool(arg_keep_ring_field.getValue()) << ",\n";
+	o << "  \"memory_source_layer\": " << json_str(arg_memory_source_layer.getValue()) << ",\n";
+	o << "  \"observations\": " << nObs << ",\n";
+	o << "  \"local_maps\": " << nLocalMaps << ",\n";
+	o << "  \"local_maps_per_trigger\": {\n";
+	for (auto it = localMapsPerTrigger.begin(); it != localMapsPerTrigger.end(); ++it)
+	{
+		o << "    " << json_str(it->first) << ": " << it->second
+		  << (std::next(it) != localMapsPerTrigger.end() ? "," : "") << "\n";
+	}
+	o << "  },\n";
+	o << "  \"stages\": {\n";
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		const auto& [name, s] = stages[i];
+		o << "    " << json_str(name) << ": {\n";
+		o << "      \"calls\": " << s.calls << ",\n";
+		o << "      \"total_time_s\": " << s.time << ",\n";
+		o << "      \"mean_time_ms\": " << (s.calls ? 1e3 * s.time / s.calls : 0) << ",\n";
+		o << "      \"input_points\": " << s.input_points << ",\n";
+		o << "      \"output_points\": " << s.output_points << ",\n";
+		o << "      \"points_per_second\": " << (s.time > 0 ? s.input_points / s.time : 0)
+		  << "\n";
+		o << "    }" << (i + 1 < stages.size() ? "," : "") << "\n";
+	}
+	o << "  }\n";
+	o << "}\n";
+}
+
+int run()
+{
+	// Load pipelines, as in LocalObstaclesNode::read_parameters():
+	ASSERT_FILE_EXISTS_(arg_pipeline.getValue());
+	const auto cfg = mrpt::containers::yaml::FromFile(arg_pipeline.getValue());
+	ASSERT_(cfg.has("generators"));
+	ASSERT_(cfg.has("per_observation"));
+	ASSERT_(cfg.has("final"));
+
+	const auto generators = mp2p_icp_filters::generators_from_yaml(cfg["generators"]);
+	const auto perObsPipeline = mp2p_icp_filters::filter_pipeline_from_yaml(cfg["per_observation"]);
+	const auto finalPipeline = mp2p_icp_filters::filter_pipeline_from_yaml(cfg["final"]);
+
+	const double timeWindow = arg_time_window.getValue();
+	const double publishPeriod = arg_publish_period.getValue();
+	ASSERT_LE_(publishPeriod, timeWindow);
+
+#if MRPT_VERSION < 0x020b04
+	if (arg_deskew.getValue() || arg_keep_ring_field.getValue())
+		std::cerr << "Warning: --deskew and --keep-ring-field require MRPT>=2.11.4, and are "
+					 "ignored with this MRPT version.\n";
+#endif
+
+	std::cerr << "Loading rawlog: " << arg_rawlog.getValue() << "\n";
+	mrpt::obs::CRawlog rawlog;
+	if (!rawlog.loadFromRawLogFile(arg_rawlog.getValue()))
+		THROW_EXCEPTION_FMT("Error loading rawlog '%s'", arg_rawlog.getValue().c_str());
+
+	// Flatten into a list of observations, in time order:
+	std::vector<mrpt::obs::CObservation::Ptr> observations;
+	for (size_t i = 0; i < rawlog.size(); i++)
+	{
+		const auto e = rawlog.getAsGeneric(i);
+		if (auto sf = std::dynamic_pointer_cast<mrpt::obs::CSensoryFrame>(e); sf)
+			for (const auto& o : *sf) observations.push_back(o);
+		else if (auto o = std::dynamic_pointer_cast<mrpt::obs::CObservation>(e); o)
+			observations.push_back(o);
+	}
+	std::stable_sort(
+		observations.begin(), observations.end(),
+		[](const auto& a, const auto& b) { return a->timestamp < b->timestamp; });
+
+	// Robot poses from odometry, if present. Otherwise, the robot is assumed
+	// to be static. The whole dataset is kept in the buffer:
+	PoseBuffer robotPoses;
+	robotPoses.max_length = std::numeric_limits<double>::max();
+	for (const auto& o : observations)
+	{
+		if (auto odo = std::dynamic_pointer_cast<mrpt::obs::CObservationOdometry>(o); odo)
+			robotPoses.add(
+				mrpt::Clock::toDouble(odo->timestamp), mrpt::poses::CPose3D(odo->odometry));
+	}
+	const bool hasOdometry = !robotPoses.empty();
+
+	// Sensor topics, as the node 'source_topics_*' params, for the
+	// all-sensors-fresh publish trigger:
+	std::set<std::string> sourceTopics;
+	for (const auto& o : observations)
+		if (!std::dynamic_pointer_cast<mrpt::obs::CObservationOdometry>(o))
+			sourceTopics.insert(o->sensorLabel);
+
+	using mrpt_pointcloud_pipeline::PublishTriggers;
+	PublishTriggers triggers;
+	triggers.publish_on_all_sensors_fresh = arg_all_sensors_fresh.getValue();
+	triggers.publish_every_n_scans = arg_publish_every_n_scans.getValue();
+	triggers.source_topics.assign(sourceTopics.begin(), sourceTopics.end());
+	ASSERT_GE_(triggers.publish_every_n_scans, 0);
+
+	mrpt_pointcloud_pipeline::PointCloudOptions cloudOptions;
+	cloudOptions.deskew_enable = arg_deskew.getValue();
+	cloudOptions.keep_ring_field = arg_keep_ring_field.getValue();
+	ASSERT_GT_(arg_deskew_time_bins.getValue(), 0);
+	cloudOptions.deskew_time_bins = static_cast<size_t>(arg_deskew_time_bins.getValue());
+
+	const bool memoryEnabled = !arg_memory_source_layer.getValue().empty();
+	DecayingVoxelMap memory;
+	memory.params.voxel_size = arg_memory_voxel_size.getValue();
+	memory.params.ttl = arg_memory_ttl.getValue();
+	ASSERT_GE_(arg_memory_min_hits.getValue(), 0);
+	memory.params.min_hits = static_cast<uint32_t>(arg_memory_min_hits.getValue());
+	memory.params.ray_clearing = !arg_memory_no_ray_clearing.getValue();
+	memory.params.max_ray_length = arg_memory_max_ray_length.getValue();
+	ASSERT_GT_(memory.params.voxel_size, 0);
+
+	StageStats stConversion, stGenerators, stPerObs, stMerge, stMemory, stFinal;
+	size_t nObs = 0;
+	std::map<std::string, size_t> localMapsPerTrigger;
+	mrpt_pointcloud_pipeline::ObservationList history;	// Arrival order
+	uint64_t head = 0;
+	double nextPublish = 0;
+	mrpt::system::CTicTac tictac;
+
+	// Same as LocalObstaclesNode::on_do_publish(), with the shared functions
+	// in local_map_builder.h:
+	const auto buildLocalMap = [&](const std::string& trigger)
+	{
+		// Skip if nothing new arrived. Unlike in the node, the memory does
+		// not decay between observations, since there is no clock other
+		// than the dataset time:
+		if (head == triggers.last_head()) return;
+
+		const auto windowObs = mrpt_pointcloud_pipeline::select_time_window(history, timeWindow);
+		const auto obs = arg_one_obs_per_topic.getValue()
+							 ? mrpt_pointcloud_pipeline::latest_per_topic(windowObs)
+							 : windowObs;
+		if (obs.empty()) return;
+
+		const auto curRobotPose = obs.back()->robot_pose;
+
+		mp2p_icp::metric_map_t mm;
+		size_t nIn = 0;
+		for (const auto& ipt : obs) nIn += count_points(*ipt->processed->map);
+		tictac.Tic();
+		mrpt_pointcloud_pipeline::merge_observations(obs, curRobotPose, mm);
+		stMerge.add(tictac.Tac(), nIn, count_points(mm));
+
+		if (memoryEnabled)
+		{
+			size_t nMemIn = 0;
+			tictac.Tic();
+			const auto out = mrpt_pointcloud_pipeline::update_memory(
+				memory, windowObs, arg_memory_source_layer.getValue(), obs.back()->timestamp,
+				curRobotPose,
+				[](const mrpt_pointcloud_pipeline::InfoPerTimeStep& ipt)
+					-> const mp2p_icp::metric_map_t& { return *ipt.processed->map; },
+				&nMemIn);
+			mm.layers[arg_memory_output_layer.getValue()] = out;
+			stMemory.add(tictac.Tac(), nMemIn, out->size());
+		}
+
+		triggers.on_local_map(head, obs.back()->timestamp);
+
+		const size_t nFinalIn = count_points(mm);
+		tictac.Tic();
+		mp2p_icp_filters::apply_filter_pipeline(finalPipeline, mm);
+		stFinal.add(tictac.Tac(), nFinalIn, count_points(mm));
+
+		localMapsPerTrigger[trigger]++;
+	};
+
+	for (const auto& o : observations)
+	{
+		if (std::dynamic_pointer_cast<mrpt::obs::CObservationOdometry>(o)) continue;
+
+		const double t = mrpt::Clock::toDouble(o->timestamp);
+
+		// Publish timer ticks, in dataset time, before this observation:
+		if (nextPublish == 0) nextPublish = t + publishPeriod;
+		for (; nextPublish <= t; nextPublish += publishPeriod) buildLocalMap("timer");
+
+		auto ipt = std::make_shared<mrpt_pointcloud_pipeline::InfoPerTimeStep>();
+		ipt->sourceTopic = o->sensorLabel;
+		ipt->timestamp = t;
+		if (hasOdometry)
+		{
+			if (auto p = robotPoses.interpolate(t); p)
+				ipt->robot_pose = *p;
+			else
+				continue;  // Out of the odometry time range, as in the node
+		}
+
+		// Point cloud conversion, as in on_new_sensor_pointcloud():
+		ipt->observation = o;
+		if (auto pc = std::dynamic_pointer_cast<mrpt::obs::CObservationPointCloud>(o);
+			pc && pc->pointcloud)
+		{
+			const size_t nPcIn = pc->pointcloud->size();
+			tictac.Tic();
+
+			// Work on copies, so the loaded dataset is left untouched:
+			auto newPc = std::make_shared<mrpt::obs::CObservationPointCloud>(*pc);
+			auto pts = pc->pointcloud;
+			if (cloudOptions.deskew_enable)
+			{
+				pts = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+					pc->pointcloud->duplicateGetSmartPtr());
+				ASSERT_(pts);
+			}
+			newPc->pointcloud = mrpt_pointcloud_pipeline::prepare_point_cloud(
+				pts, cloudOptions, pc->sensorPose, ipt->robot_pose, t, robotPoses);
+			ipt->observation = newPc;
+			stConversion.add(tictac.Tac(), nPcIn, newPc->pointcloud->size());
+		}
+
+		// Per-observation stage, on arrival (as with 'process_on_arrival'):
+		auto& map = ipt->processed->map;
+		map = mp2p_icp::metric_map_t::Create();
+
+		tictac.Tic();
+		mp2p_icp_filters::apply_generators(generators, *ipt->observation, *map);
+		stGenerators.add(tictac.Tac(), count_points(*ipt->observation), count_points(*map));
+
+		const size_t nPerObsIn = count_points(*map);
+		tictac.Tic();
+		mp2p_icp_filters::apply_filter_pipeline(perObsPipeline, *map);
+		stPerObs.add(tictac.Tac(), nPerObsIn, count_points(*map));
+
+		history.push_back(ipt);
+		nObs++;
+		head++;
+
+		// Entries out of the time window are no longer used:
+		history.erase(
+			history.begin(),
+			std::find_if(
+				history.begin(), history.end(),
+				[&](const auto& e) { return e->timestamp >= t - timeWindow; }));
+
+		switch (triggers.on_new_observation(o->sensorLabel, t, head))
+		{
+			case PublishTriggers::Trigger::EveryNScans:
+				buildLocalMap("every_n_scans");
+				break;
+			case PublishTriggers::Trigger::AllSensorsFresh:
+				buildLocalMap("all_sensors_fresh");
+				break;
+			case PublishTriggers::Trigger::None:
+				break;
+		}
+	}
+	buildLocalMap("timer");
+
+	const std::vector<std::pair<std::string, StageStats>> stages = {
+		{"conversion", stConversion},
+		{"generators", stGenerators},
+		{"per_observation", stPerObs},
+		{"merge", stMerge},
+		{"memory", stMemory},
+		{"final", stFinal}};
+
+	if (arg_output.isSet())
+	{
+		std::ofstream f(arg_output.getValue());
+		ASSERTMSG_(f.is_open(), "Cannot create output file: " + arg_output.getValue());
+		write_json(f, nObs, localMapsPerTrigger, stages);
+	}
+	else
+	{
+		write_json(std::cout, nObs, localMapsPerTrigger, stages);
+	}
+	return 0;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		// Parse arguments:
+		if (!cmd.parse(argc, argv)) return 1;  // should exit.
+
+		return run();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << mrpt::exception_to_str(e) << std::endl;
+		return 1;
+	}
+}
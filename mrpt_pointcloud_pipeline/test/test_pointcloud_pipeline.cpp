@@ -0,0 +1,701 @@
+/* +------------------------------------------------------------------------+
+   |                             mrpt_navigation                            |
+   |                                                                        |
+   | Copyright (c) 2014-2024, Individual contributors, see commit authors   |
+   | See: https://github.com/mrpt-ros-pkg/mrpt_navigation                   |
+   | All rights reserved. Released under BSD 3-Clause license. See LICENSE  |
+   +------------------------------------------------------------------------+ */
+
+#include <gtest/gtest.h>
+#include <mp2p_icp/metricmap.h>
+#include <mrpt/containers/yaml.h>
+#include <mrpt/core/bits_math.h>
+#include <mrpt/maps/CPointsMapXYZIRT.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/version.h>
+#include <mrpt_pointcloud_pipeline/decaying_voxel_map.h>
+#include <mrpt_pointcloud_pipeline/deskew.h>
+#include <mrpt_pointcloud_pipeline/filter_crop_flatten_decimate.h>
+#include <mrpt_pointcloud_pipeline/filter_ground_segmentation.h>
+#include <mrpt_pointcloud_pipeline/local_map_builder.h>
+#include <mrpt_pointcloud_pipeline/observation_ring.h>
+#include <mrpt_pointcloud_pipeline/obstacle_grid_2d.h>
+#include <mrpt_pointcloud_pipeline/points_to_ros.h>
+#include <mrpt_pointcloud_pipeline/pose_buffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+// Synthetic scene: a plane sloped along +X, as seen by a 32-ring lidar 1 m
+// over the ground under the robot, with two box obstacles on it:
+const double SCENE_SLOPE = std::tan(mrpt::DEG2RAD(8.0));
+
+struct Box
+{
+	double x0, x1, y0, y1;
+	double height;	//!< Over the plane [m]
+};
+const Box SCENE_BOXES[] = {{4.0, 4.5, -1.0, 1.0, 1.5}, {-3.5, -3.0, 2.0, 2.5, 2.0}};
+
+mrpt::maps::CPointsMap::Ptr make_sloped_scene(bool withRings)
+{
+	mrpt::maps::CPointsMap::Ptr pts;
+#if MRPT_VERSION >= 0x020b04
+	mrpt::maps::CPointsMapXYZIRT::Ptr ptsIRT;
+	if (withRings) pts = ptsIRT = mrpt::maps::CPointsMapXYZIRT::Create();
+#else
+	ASSERT_(!withRings);
+#endif
+	if (!pts) pts = mrpt::maps::CSimplePointsMap::Create();
+
+	const double sensorZ = 1.0, maxRange = 12.0;
+
+	for (int ring = 0; ring < 32; ring++)
+	{
+		const double elev = mrpt::DEG2RAD(-30.0 + ring);
+		for (int k = 0; k < 720; k++)
+		{
+			const double azim = mrpt::DEG2RAD(-180.0 + 0.5 * k + 0.25);
+			const double dx = std::cos(elev) * std::cos(azim);
+			const double dy = std::cos(elev) * std::sin(azim);
+			const double dz = std::sin(elev);
+
+			// Ray-plane intersection: sensorZ + t*dz = SCENE_SLOPE * t*dx
+			double range = maxRange;
+			bool hit = false;
+			if (const double den = dz - SCENE_SLOPE * dx; den < 0)
+			{
+				range = std::min(range, -sensorZ / den);
+				hit = true;
+			}
+
+			// Ray-box intersections (slab method):
+			for (const auto& b : SCENE_BOXES)
+			{
+				double tMin = 0, tMax = maxRange;
+				const auto slab = [&](double d, double lo, double hi)
+				{
+					if (std::abs(d) < 1e-12)
+					{
+						if (lo > 0 || hi < 0) tMax = -1;
+						return;
+					}
+					const double t0 = lo / d, t1 = hi / d;
+					tMin = std::max(tMin, std::min(t0, t1));
+					tMax = std::min(tMax, std::max(t0, t1));
+				};
+				slab(dx, b.x0, b.x1);
+				slab(dy, b.y0, b.y1);
+				if (tMax < tMin || tMin >= range) continue;
+
+				const double x = tMin * dx, z = sensorZ + tMin * dz;
+				if (z < SCENE_SLOPE * x || z > SCENE_SLOPE * x + b.height) continue;
+				range = tMin;
+				hit = true;
+			}
+			if (!hit || range >= maxRange) continue;
+
+			pts->insertPoint(range * dx, range * dy, sensorZ + range * dz);
+#if MRPT_VERSION >= 0x020b04
+			if (ptsIRT) ptsIRT->insertPointField_Ring(static_cast<uint16_t>(ring));
+#endif
+		}
+	}
+	return pts;
+}
+
+bool is_scene_ground(float x, float y, float z)
+{
+	if (std::abs(z - SCENE_SLOPE * x) > 1e-3) return false;
+	for (const auto& b : SCENE_BOXES)
+		if (x >= b.x0 - 1e-3 && x <= b.x1 + 1e-3 && y >= b.y0 - 1e-3 && y <= b.y1 + 1e-3)
+			return false;
+	return true;
+}
+
+bool is_scene_obstacle(float x, float z) { return z - SCENE_SLOPE * x > 0.25; }
+
+// Constant-velocity SE(3) motion: pose(t) = exp(t * twist)
+mrpt::poses::CPose3D constant_velocity_pose(double t)
+{
+	mrpt::math::CVectorFixedDouble<6> v;
+	v[0] = 1.0;	 // vx [m/s]
+	v[1] = 0.2;	 // vy
+	v[2] = 0.1;	 // vz
+	v[3] = 0.05;  // wx [rad/s]
+	v[4] = -0.1;  // wy
+	v[5] = 0.8;	 // wz
+	v *= t;
+	return mrpt::poses::Lie::SE<3>::exp(v);
+}
+
+double pose_error(const mrpt::poses::CPose3D& a, const mrpt::poses::CPose3D& b)
+{
+	return mrpt::poses::Lie::SE<3>::log(a - b).norm();
+}
+
+void test_ground_segmentation(bool withRings)
+{
+	mp2p_icp::metric_map_t mm;
+	const auto input = make_sloped_scene(withRings);
+	mm.layers["raw"] = input;
+
+	mrpt_pointcloud_pipeline::FilterGroundSegmentation filter;
+	filter.initialize(mrpt::containers::yaml::FromText(
+		"input_pointcloud_layer: 'raw'\n"
+		"obstacles_layer: 'obstacles'\n"
+		"ground_layer: 'ground'\n"
+		"max_slope: 15.0\n"
+		"ground_threshold: 0.10\n"));
+	filter.filter(mm);
+
+	const auto ground = mm.point_layer("ground");
+	const auto obstacles = mm.point_layer("obstacles");
+	ASSERT_TRUE(ground);
+	ASSERT_TRUE(obstacles);
+	EXPECT_EQ(ground->size() + obstacles->size(), input->size());
+
+	// Outputs keep the input class, with its extra fields:
+	EXPECT_EQ(
+		std::string(ground->GetRuntimeClass()->className),
+		std::string(input->GetRuntimeClass()->className));
+
+	size_t nGround = 0, nObstacles = 0;
+	for (size_t i = 0; i < input->size(); i++)
+	{
+		float x, y, z;
+		input->getPoint(i, x, y, z);
+		if (is_scene_ground(x, y, z)) nGround++;
+		if (is_scene_obstacle(x, z)) nObstacles++;
+	}
+	ASSERT_GT(nGround, 10000U);
+	ASSERT_GT(nObstacles, 100U);
+
+	size_t nGroundOk = 0, nObstaclesOk = 0;
+	for (size_t i = 0; i < ground->size(); i++)
+	{
+		float x, y, z;
+		ground->getPoint(i, x, y, z);
+		if (is_scene_ground(x, y, z)) nGroundOk++;
+		// No obstacle point well over the ground can be labeled as ground:
+		EXPECT_FALSE(is_scene_obstacle(x, z)) << "x=" << x << " y=" << y << " z=" << z;
+	}
+	for (size_t i = 0; i < obstacles->size(); i++)
+	{
+		float x, y, z;
+		obstacles->getPoint(i, x, y, z);
+		if (is_scene_obstacle(x, z)) nObstaclesOk++;
+	}
+
+	EXPECT_GE(nGroundOk, 0.98 * nGround);
+	EXPECT_EQ(nObstaclesOk, nObstacles);
+}
+}  // namespace
+
+#if MRPT_VERSION >= 0x020b04
+TEST(PointCloudPipeline, GroundSegmentationRings) { test_ground_segmentation(true); }
+#endif
+
+TEST(PointCloudPipeline, GroundSegmentationGrid) { test_ground_segmentation(false); }
+
+TEST(PointCloudPipeline, PointsToRosReusedMessage)
+{
+	std_msgs::msg::Header header;
+	header.frame_id = "base_link";
+
+	// The same message is reused on each publish, as for inter-process
+	// subscribers only:
+	sensor_msgs::msg::PointCloud2 msg;
+	for (bool withRings : {false, true})
+	{
+#if MRPT_VERSION < 0x020b04
+		if (withRings) continue;
+#endif
+		const auto pts = make_sloped_scene(withRings);
+
+		mrpt_pointcloud_pipeline::points_to_ros(*pts, header, msg);
+		const size_t nFields = msg.fields.size();
+		const size_t nBytes = msg.data.size();
+		EXPECT_EQ(msg.width * msg.height, pts->size());
+		EXPECT_EQ(nBytes, static_cast<size_t>(msg.row_step) * msg.height);
+
+		mrpt_pointcloud_pipeline::points_to_ros(*pts, header, msg);
+		EXPECT_EQ(msg.fields.size(), nFields);
+		EXPECT_EQ(msg.data.size(), nBytes);
+		EXPECT_EQ(msg.width * msg.height, pts->size());
+	}
+}
+
+TEST(PointCloudPipeline, ObservationRingConcurrentPushSnapshot)
+{
+	struct Entry
+	{
+		int writer, index;
+	};
+	const int nWriters = 4, nPushesPerWriter = 20000;
+	const size_t capacity = 16;
+
+	ObservationRing<Entry> ring(capacity);
+	std::atomic_bool done = false;
+	std::atomic_size_t nSnapshots = 0;
+
+	std::thread reader(
+		[&]()
+		{
+			while (!done)
+			{
+				uint64_t head;
+				const auto snap = ring.snapshot(&head);
+				EXPECT_EQ(snap.size(), std::min<uint64_t>(head, capacity));
+
+				// Entries of each writer come in their insertion order:
+				std::vector<int> lastIndex(nWriters, -1);
+				for (const auto& e : snap)
+				{
+					ASSERT_TRUE(e);
+					EXPECT_GT(e->index, lastIndex.at(e->writer));
+					lastIndex.at(e->writer) = e->index;
+				}
+				nSnapshots++;
+			}
+		});
+
+	std::vector<std::thread> writers;
+	for (int w = 0; w < nWriters; w++)
+		writers.emplace_back(
+			[&ring, w]()
+			{
+				for (int i = 0; i < nPushesPerWriter; i++) ring.push(Entry{w, i});
+			});
+	for (auto& t : writers) t.join();
+	done = true;
+	reader.join();
+
+	EXPECT_GT(nSnapshots.load(), 0U);
+	EXPECT_EQ(ring.head(), static_cast<uint64_t>(nWriters * nPushesPerWriter));
+
+	// The last writer to finish left its last entry as the newest one:
+	const auto snap = ring.snapshot();
+	ASSERT_EQ(snap.size(), capacity);
+	EXPECT_EQ(snap.back()->index, nPushesPerWriter - 1);
+}
+
+TEST(PointCloudPipeline, PoseBufferInterpolation)
+{
+	PoseBuffer buf;
+	EXPECT_TRUE(buf.empty());
+	EXPECT_FALSE(buf.interpolate(0.0).has_value());
+
+	// Samples every 0.1 s, added out of order:
+	for (int i : {0, 1, 2, 4, 5, 3, 6, 7, 8, 9, 10})
+		buf.add(0.1 * i, constant_velocity_pose(0.1 * i));
+	EXPECT_FALSE(buf.empty());
+
+	// Exact sample times, and SE(3) geodesic interpolation in between, which
+	// is exact for a constant velocity motion:
+	for (double t : {0.0, 0.3, 0.35, 0.12, 0.71, 0.999, 1.0})
+	{
+		const auto p = buf.interpolate(t);
+		ASSERT_TRUE(p.has_value()) << "t=" << t;
+		EXPECT_LT(pose_error(*p, constant_velocity_pose(t)), 1e-6) << "t=" << t;
+	}
+
+	// Out of the buffer time range:
+	EXPECT_FALSE(buf.interpolate(-0.01).has_value());
+
+	buf.max_extrapolation = 0.1;
+	const auto pLast = buf.interpolate(1.05);
+	ASSERT_TRUE(pLast.has_value());
+	EXPECT_LT(pose_error(*pLast, constant_velocity_pose(1.0)), 1e-9);
+	EXPECT_FALSE(buf.interpolate(1.11).has_value());
+}
+
+TEST(PointCloudPipeline, PoseBufferMaxLength)
+{
+	PoseBuffer buf;
+	buf.max_length = 0.5;
+
+	for (int i = 0; i <= 20; i++) buf.add(0.1 * i, constant_velocity_pose(0.1 * i));
+
+	// Only [1.5, 2.0] is kept:
+	EXPECT_FALSE(buf.interpolate(1.4).has_value());
+	const auto p = buf.interpolate(1.55);
+	ASSERT_TRUE(p.has_value());
+	EXPECT_LT(pose_error(*p, constant_velocity_pose(1.55)), 1e-6);
+}
+
+TEST(PointCloudPipeline, ObstacleGrid2DRaycasting)
+{
+	ObstacleGrid2D grid;
+	grid.resize(0.1, 2.0);
+	ASSERT_EQ(grid.size(), 20);
+
+	grid.recenter(10.0, -5.0);
+	EXPECT_EQ(grid.origin_cx(), 90);
+	EXPECT_EQ(grid.origin_cy(), -60);
+
+	const auto cell = [&](const std::vector<int8_t>& g, double x, double y)
+	{
+		const int cx = static_cast<int>(std::floor(x / grid.resolution())) - grid.origin_cx();
+		const int cy = static_cast<int>(std::floor(y / grid.resolution())) - grid.origin_cy();
+		return g.at(static_cast<size_t>(cy) * grid.size() + cx);
+	};
+
+	// One obstacle ahead (+X) of the sensor, and another one out of the grid
+	// to its left (+Y):
+	const std::vector<float> xs = {10.55f, 10.05f}, ys = {-4.95f, -2.0f};
+	std::vector<int8_t> g = {1, 2, 3};	// reused buffer
+	grid.rasterize(xs, ys, 10.05, -4.95, g);
+	ASSERT_EQ(g.size(), 400U);
+
+	EXPECT_EQ(cell(g, 10.55, -4.95), ObstacleGrid2D::OCCUPIED);
+	for (double x = 10.05; x < 10.5; x += 0.1) EXPECT_EQ(cell(g, x, -4.95), ObstacleGrid2D::FREE);
+	EXPECT_EQ(cell(g, 10.65, -4.95), ObstacleGrid2D::UNKNOWN);	// Behind the obstacle
+
+	// The ray towards the point out of the grid clears up to the grid border:
+	for (double y = -4.95; y < -4.0; y += 0.1) EXPECT_EQ(cell(g, 10.05, y), ObstacleGrid2D::FREE);
+
+	// Not observed at all:
+	EXPECT_EQ(cell(g, 9.55, -5.55), ObstacleGrid2D::UNKNOWN);
+	EXPECT_EQ(std::count(g.begin(), g.end(), ObstacleGrid2D::OCCUPIED), 1);
+}
+
+namespace
+{
+std::vector<mrpt::math::TPoint3D> voxel_centers(const DecayingVoxelMap& m)
+{
+	std::vector<mrpt::math::TPoint3D> out;
+	m.get_voxels([&](double x, double y, double z) { out.emplace_back(x, y, z); });
+	std::sort(
+		out.begin(), out.end(), [](const auto& a, const auto& b)
+		{ return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); });
+	return out;
+}
+}  // namespace
+
+TEST(PointCloudPipeline, DecayingVoxelMapKeys)
+{
+	DecayingVoxelMap m;
+	m.params.voxel_size = 0.1;
+	m.params.ray_clearing = false;
+
+	// Negative indices, and up to the 21-bit limits (+-1e6 cells):
+	const std::vector<double> xs = {-0.05, 0.05, -99999.95, 99999.95};
+	const std::vector<double> ys = {-123.45, 0.05, 99999.95, -99999.95};
+	const std::vector<double> zs = {7.01, -0.05, -0.05, -99999.95};
+	m.insert({0, 0, 0}, xs, ys, zs, 0.0);
+	ASSERT_EQ(m.size(), 4U);
+
+	for (const auto& c : voxel_centers(m))
+	{
+		// Each center must be that of the voxel of one input point:
+		bool found = false;
+		for (size_t i = 0; i < xs.size(); i++)
+			found = found || (std::abs(c.x - xs[i]) < 0.05 + 1e-6 &&
+							  std::abs(c.y - ys[i]) < 0.05 + 1e-6 &&
+							  std::abs(c.z - zs[i]) < 0.05 + 1e-6);
+		EXPECT_TRUE(found) << c.asString();
+	}
+}
+
+TEST(PointCloudPipeline, DecayingVoxelMapRayClearing)
+{
+	DecayingVoxelMap m;
+	m.params.voxel_size = 0.1;
+
+	// Obstacles on the ray below, and another one off it:
+	const mrpt::math::TPoint3D sensor(0.05, 0.05, 0.05);
+	const std::vector<double> xs = {1.05, 2.05, 0.05}, ys = {1.05, 2.05, 2.05},
+							  zs = {0.55, 1.05, 0.05};
+	m.insert(sensor, xs, ys, zs, 0.0);
+	ASSERT_EQ(m.size(), 3U);
+
+	// A ray that crosses the first two voxels (3D DDA), ending at a new one:
+	const std::vector<double> x2 = {3.05}, y2 = {3.05}, z2 = {1.55};
+	DecayingVoxelMap shortRays = m;
+	m.insert(sensor, x2, y2, z2, 1.0);
+
+	const auto c = voxel_centers(m);
+	ASSERT_EQ(c.size(), 2U);
+	EXPECT_NEAR(c[0].x, 0.05, 1e-6);  // The one off the ray
+	EXPECT_NEAR(c[0].y, 2.05, 1e-6);
+	EXPECT_NEAR(c[1].x, 3.05, 1e-6);  // The ray end
+	EXPECT_NEAR(c[1].z, 1.55, 1e-6);
+
+	// Rays are only cleared up to max_ray_length: only the first one (at
+	// ~1.5 m from the sensor) is cleared:
+	shortRays.params.max_ray_length = 2.0;
+	shortRays.insert(sensor, x2, y2, z2, 1.0);
+	EXPECT_EQ(shortRays.size(), 3U);
+
+	// A new point in an existing voxel does not clear it:
+	m.insert(sensor, x2, y2, z2, 2.0);
+	EXPECT_EQ(m.size(), 2U);
+}
+
+TEST(PointCloudPipeline, DecayingVoxelMapDecayAndMinHits)
+{
+	DecayingVoxelMap m;
+	m.params.voxel_size = 0.1;
+	m.params.ttl = 5.0;
+	m.params.ray_clearing = false;
+
+	const std::vector<double> a = {1.0}, b = {2.0};
+	m.insert({0, 0, 0}, a, a, a, 0.0);
+	m.insert({0, 0, 0}, b, b, b, 3.0);
+	m.insert({0, 0, 0}, b, b, b, 3.5);
+	ASSERT_EQ(m.size(), 2U);
+
+	m.params.min_hits = 2;
+	EXPECT_EQ(voxel_centers(m).size(), 1U);	 // Only `b` was seen twice
+	m.params.min_hits = 1;
+	EXPECT_EQ(voxel_centers(m).size(), 2U);
+
+	m.decay(5.0);
+	EXPECT_EQ(m.size(), 2U);
+	m.decay(5.5);
+	EXPECT_EQ(m.size(), 1U);  // `a` not seen for more than ttl
+	m.decay(8.5);
+	EXPECT_EQ(m.size(), 1U);  // `b` last seen at 3.5
+	m.decay(8.6);
+	EXPECT_EQ(m.size(), 0U);
+}
+
+#if MRPT_VERSION >= 0x020b04
+TEST(PointCloudPipeline, DeskewConstantVelocity)
+{
+	PoseBuffer robotPoses;
+	for (int i = 0; i <= 100; i++)
+		robotPoses.add(0.01 * i, constant_velocity_pose(0.01 * i));
+
+	const double stamp = 0.5, scanDuration = 0.1;
+	const auto robotPose = constant_velocity_pose(stamp);
+	const mrpt::poses::CPose3D sensorPose(0.2, 0.0, 0.5, mrpt::DEG2RAD(10.0), 0, 0);
+
+	// A scan of static world points, each one taken at a different time
+	// within the scan, as seen by the moving sensor:
+	mrpt::maps::CPointsMapXYZIRT pts;
+	std::vector<mrpt::math::TPoint3D> expected;
+	const int nPts = 1000;
+	for (int i = 0; i < nPts; i++)
+	{
+		const double a = 2 * M_PI * i / nPts;
+		const mrpt::math::TPoint3D world(5 * std::cos(a), 5 * std::sin(a), 0.5 * std::sin(3 * a));
+		const double dt = -scanDuration + scanDuration * i / (nPts - 1);
+
+		const auto sensorAtDt = constant_velocity_pose(stamp + dt) + sensorPose;
+		const auto local = sensorAtDt.inverseComposePoint(world);
+		pts.insertPoint(local.x, local.y, local.z);
+		pts.insertPointField_Timestamp(static_cast<float>(dt));
+
+		expected.push_back((robotPose + sensorPose).inverseComposePoint(world));
+	}
+
+	const auto maxError = [&]()
+	{
+		double err = 0;
+		for (int i = 0; i < nPts; i++)
+		{
+			float x, y, z;
+			pts.getPoint(i, x, y, z);
+			err = std::max(err, (mrpt::math::TPoint3D(x, y, z) - expected[i]).norm());
+		}
+		return err;
+	};
+
+	// Motion distortion, before deskewing:
+	EXPECT_GT(maxError(), 0.05);
+
+	ASSERT_TRUE(mrpt_pointcloud_pipeline::deskew_point_cloud(
+		pts, sensorPose, robotPose, stamp, robotPoses, 100));
+
+	// Remaining error: at most that of the time bins (1 ms):
+	EXPECT_LT(maxError(), 0.01);
+
+	// Clouds without timestamps are left untouched:
+	mrpt::maps::CSimplePointsMap noTimes;
+	noTimes.insertPoint(1, 2, 3);
+	EXPECT_FALSE(mrpt_pointcloud_pipeline::deskew_point_cloud(
+		noTimes, sensorPose, robotPose, stamp, robotPoses, 100));
+}
+#endif
+
+TEST(PointCloudPipeline, LocalMapObservationSelection)
+{
+	using namespace mrpt_pointcloud_pipeline;
+
+	ObservationList obs;  // In arrival order
+	for (const auto& [topic, t] : std::vector<std::pair<std::string, double>>{
+			 {"a", 1.0}, {"b", 0.95}, {"a", 0.7}, {"b", 1.1}, {"a", 0.85}})
+	{
+		auto e = std::make_shared<InfoPerTimeStep>();
+		e->sourceTopic = topic;
+		e->timestamp = t;
+		obs.push_back(e);
+	}
+
+	// Sorted, within [1.1 - 0.3, 1.1]:
+	const auto window = select_time_window(obs, 0.3);
+	ASSERT_EQ(window.size(), 4U);
+	for (size_t i = 1; i < window.size(); i++)
+		EXPECT_LT(window[i - 1]->timestamp, window[i]->timestamp);
+	EXPECT_DOUBLE_EQ(window.front()->timestamp, 0.85);
+	EXPECT_DOUBLE_EQ(window.back()->timestamp, 1.1);
+
+	const auto latest = latest_per_topic(window);
+	ASSERT_EQ(latest.size(), 2U);
+	EXPECT_EQ(latest[0]->sourceTopic, "a");
+	EXPECT_DOUBLE_EQ(latest[0]->timestamp, 1.0);
+	EXPECT_EQ(latest[1]->sourceTopic, "b");
+	EXPECT_DOUBLE_EQ(latest[1]->timestamp, 1.1);
+}
+
+TEST(PointCloudPipeline, PublishTriggers)
+{
+	using Trigger = mrpt_pointcloud_pipeline::PublishTriggers::Trigger;
+
+	mrpt_pointcloud_pipeline::PublishTriggers pt;
+	pt.source_topics = {"a", "b"};
+
+	// Only the timer, by default:
+	EXPECT_EQ(pt.on_new_observation("a", 1.0, 1), Trigger::None);
+
+	pt.publish_on_all_sensors_fresh = true;
+	EXPECT_EQ(pt.on_new_observation("a", 1.1, 2), Trigger::None);  // "b" not seen yet
+	EXPECT_EQ(pt.on_new_observation("b", 1.15, 3), Trigger::AllSensorsFresh);
+
+	pt.on_local_map(3, 1.15);
+	EXPECT_EQ(pt.last_head(), 3U);
+	EXPECT_EQ(pt.on_new_observation("a", 1.2, 4), Trigger::None);
+	EXPECT_EQ(pt.on_new_observation("b", 1.25, 5), Trigger::AllSensorsFresh);
+
+	pt.publish_on_all_sensors_fresh = false;
+	pt.publish_every_n_scans = 3;
+	pt.on_local_map(5, 1.25);
+	EXPECT_EQ(pt.on_new_observation("a", 1.3, 6), Trigger::None);
+	EXPECT_EQ(pt.on_new_observation("b", 1.35, 7), Trigger::None);
+	EXPECT_EQ(pt.on_new_observation("a", 1.4, 8), Trigger::EveryNScans);
+}
+
+namespace
+{
+mrpt::maps::CPointsMap::Ptr crop_flatten_decimate(
+	const mrpt::maps::CPointsMap::Ptr& input, const std::string& extraParams)
+{
+	mp2p_icp::metric_map_t mm;
+	mm.layers["raw"] = input;
+
+	mrpt_pointcloud_pipeline::FilterCropFlattenDecimate filter;
+	filter.initialize(mrpt::containers::yaml::FromText(
+		"input_pointcloud_layer: 'raw'\n"
+		"output_pointcloud_layer: 'output'\n"
+		"min_z: 0.1\n"
+		"max_z: 1.5\n"
+		"min_range: 0.05\n"
+		"max_range: 10.0\n"
+		"near_range: 2.0\n"
+		"near_resolution: 0.1\n"
+		"far_resolution: 0.5\n"
+		"flatten_to: 1.0\n" +
+		extraParams));
+	filter.filter(mm);
+
+	const auto out = mm.point_layer("output");
+	EXPECT_TRUE(out);
+	for (size_t i = 0; out && i < out->size(); i++)
+	{
+		float x, y, z;
+		out->getPoint(i, x, y, z);
+		EXPECT_FLOAT_EQ(z, 1.0f);  // flatten_to
+	}
+	return out;
+}
+
+bool has_point_near(const mrpt::maps::CPointsMap& pts, float x, float y, float tol = 1e-4f)
+{
+	for (size_t i = 0; i < pts.size(); i++)
+	{
+		float px, py, pz;
+		pts.getPoint(i, px, py, pz);
+		if (std::abs(px - x) < tol && std::abs(py - y) < tol) return true;
+	}
+	return false;
+}
+}  // namespace
+
+TEST(PointCloudPipeline, CropFlattenDecimateCropAndBins)
+{
+	auto input = mrpt::maps::CSimplePointsMap::Create();
+
+	// Out of the height or range limits:
+	input->insertPoint(0.5, 0.5, 0.05);	 // too low
+	input->insertPoint(0.5, 0.5, 1.6);	 // too high
+	input->insertPoint(0.02, 0.02, 1.0);  // too close
+	input->insertPoint(8.0, -8.0, 1.0);	 // too far
+
+	// Two near points in the same 0.1 m cell, at negative coordinates:
+	input->insertPoint(-0.12, -0.13, 0.5);
+	input->insertPoint(-0.18, -0.11, 1.2);
+	// A near point in the mirrored, positive cell:
+	input->insertPoint(0.12, 0.13, 0.5);
+	// Two far points in the same 0.5 m cell (negative Y):
+	input->insertPoint(3.1, -3.1, 0.5);
+	input->insertPoint(3.3, -3.4, 1.0);
+
+	for (bool closestToAverage : {true, false})
+	{
+		const auto out = crop_flatten_decimate(
+			input, std::string("closest_to_average: ") + (closestToAverage ? "true" : "false"));
+		ASSERT_TRUE(out);
+		ASSERT_EQ(out->size(), 3U) << "closest_to_average=" << closestToAverage;
+
+		EXPECT_TRUE(has_point_near(*out, 0.12f, 0.13f));
+		if (closestToAverage)
+		{
+			// Input points closest to each cell average:
+			EXPECT_TRUE(
+				has_point_near(*out, -0.12f, -0.13f) || has_point_near(*out, -0.18f, -0.11f));
+			EXPECT_TRUE(has_point_near(*out, 3.1f, -3.1f) || has_point_near(*out, 3.3f, -3.4f));
+		}
+		else
+		{
+			// Cell averages:
+			EXPECT_TRUE(has_point_near(*out, -0.15f, -0.12f));
+			EXPECT_TRUE(has_point_near(*out, 3.2f, -3.25f));
+		}
+	}
+}
+
+TEST(PointCloudPipeline, CropFlattenDecimateManyCells)
+{
+	// Many more cells than the initial hash table size, each one with two
+	// points, so the table has to grow and probe correctly:
+	auto input = mrpt::maps::CSimplePointsMap::Create();
+	const int n = 150;	// cells per side, 0.1 m each: all within near_range
+	for (int rep = 0; rep < 2; rep++)
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				input->insertPoint(
+					-7.5 + 0.1 * i + 0.03 + 0.04 * rep, -7.5 + 0.1 * j + 0.05, 0.5 + rep);
+
+	const auto out = crop_flatten_decimate(
+		input, "near_range: 20.0\nmax_range: 20.0\nclosest_to_average: false");
+	ASSERT_TRUE(out);
+	EXPECT_EQ(out->size(), static_cast<size_t>(n * n));
+
+	// Each output is the average of its two points, at the cell center:
+	for (size_t k = 0; k < out->size(); k++)
+	{
+		float x, y, z;
+		out->getPoint(k, x, y, z);
+		const double fx = (x + 7.5) / 0.1, fy = (y + 7.5) / 0.1;
+		EXPECT_NEAR(fx - std::floor(fx), 0.5, 1e-3);
+		EXPECT_NEAR(fy - std::floor(fy), 0.5, 1e-3);
+	}
+}
@@ -29,7 +29,7 @@ def generate_launch_description():
         condition = IfCondition(use_composable),
         name='demo_composable_container',
         package = 'rclcpp_components',
-        executable = 'component_container',
+        executable = 'component_container_mt',
         namespace = '',
         output = 'screen',
     )